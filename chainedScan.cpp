@@ -0,0 +1,36 @@
+#include "chainedScan.h"
+
+void PostTileCount(std::atomic<uint32_t>& entry, uint32_t tile, uint32_t count,
+                   WaitPolicy waitPolicy, ParkingLot& lot) {
+    entry.store(count | (tile == 0 ? FLAG_INCLUSIVE : FLAG_READY), std::memory_order_relaxed);
+    WakeWaiters(waitPolicy, lot, entry);
+}
+
+uint32_t LookbackTileCount(std::atomic<uint32_t>* status, size_t stride, uint32_t tile,
+                           uint32_t count, WaitPolicy waitPolicy, ParkingLot& lot) {
+    if (tile == 0) {
+        return 0;
+    }
+    uint32_t exclusive = 0;
+    uint32_t lookbackId = tile - 1;
+    Waiter waiter(waitPolicy, lot);
+    while (true) {
+        std::atomic<uint32_t>& entry = status[lookbackId * stride];
+        const uint32_t flagPayload = entry.load(std::memory_order_relaxed);
+        const uint32_t flag = flagPayload & FLAG_MASK;
+        if (flag == FLAG_NOT_READY) {
+            waiter.Wait(entry, flagPayload);
+            continue;
+        }
+        exclusive += flagPayload & COUNT_MASK;
+        if (flag == FLAG_INCLUSIVE) {
+            break;
+        }
+        lookbackId -= 1;
+        waiter.Reset();
+    }
+    std::atomic<uint32_t>& self = status[tile * stride];
+    self.store((exclusive + count) | FLAG_INCLUSIVE, std::memory_order_relaxed);
+    WakeWaiters(waitPolicy, lot, self);
+    return exclusive;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "waitPolicy.h"
+
+// Building blocks shared by the primitives that chain per-tile counts through the stress kernel's
+// lookback. A status word holds a count below 2^30 beside the READY/INCLUSIVE flags; entry t of a
+// chain lives at status[t * stride], so several chains (e.g. one per radix bin) can interleave.
+
+const uint32_t COUNT_MASK = ~FLAG_MASK;
+// Inputs of a chained primitive must be shorter than this, or a count would run into the flags.
+const size_t MAX_CHAINED_ELEMENTS = size_t(1) << 30;
+
+// Posts this tile's own count. Tile 0 has no predecessors, so it posts INCLUSIVE straight away.
+void PostTileCount(std::atomic<uint32_t>& entry, uint32_t tile, uint32_t count,
+                   WaitPolicy waitPolicy, ParkingLot& lot);
+
+// Walks back from tile - 1, summing READY counts until the first INCLUSIVE predecessor, then posts
+// this tile's INCLUSIVE count. Returns the exclusive prefix of the chain at tile.
+uint32_t LookbackTileCount(std::atomic<uint32_t>* status, size_t stride, uint32_t tile,
+                           uint32_t count, WaitPolicy waitPolicy, ParkingLot& lot);
+
+// Runs body(workerIndex) on workerCount threads, the last one on the calling thread.
+template <typename Body>
+void RunWorkers(uint32_t workerCount, const Body& body) {
+    std::vector<std::thread> threads;
+    threads.reserve(workerCount - 1);
+    for (uint32_t w = 0; w + 1 < workerCount; ++w) {
+        threads.emplace_back(body, w);
+    }
+    body(workerCount - 1);
+    for (auto& t : threads) {
+        t.join();
+    }
+}
@@ -0,0 +1,70 @@
+#include "checkpoint.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace {
+
+const char CHECKPOINT_MAGIC[8] = {'M', 'M', 'R', 'C', 'K', 'P', 'T', '1'};
+
+// The file: the magic, then the state as this build lays it out. A build with a different layout
+// rejects the file by its size.
+struct CheckpointFile {
+    char magic[8];
+    CampaignState state;
+};
+
+}  // namespace
+
+void CampaignState::AddFailing(uint32_t trial, uint64_t seed) {
+    if (failingCount < MAX_FAILING_TRIALS) {
+        failing[failingCount++] = {trial, seed};
+    }
+}
+
+bool SaveCheckpoint(const char* path, const CampaignState& state) {
+    CheckpointFile file = {};
+    memcpy(file.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    file.state = state;
+
+    const std::string temporary = std::string(path) + ".tmp";
+    const int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("Failed to write checkpoint %s.\n", temporary.c_str());
+        return false;
+    }
+    const bool written = write(fd, &file, sizeof(file)) == (ssize_t)sizeof(file) && !fsync(fd);
+    close(fd);
+    if (!written || rename(temporary.c_str(), path)) {
+        printf("Failed to write checkpoint %s.\n", path);
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LoadCheckpoint(const char* path, CampaignState* state) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("No checkpoint at %s.\n", path);
+        return false;
+    }
+    CheckpointFile file;
+    // One byte more than a checkpoint, to tell a longer file from a valid one.
+    char extra;
+    const bool valid = read(fd, &file, sizeof(file)) == (ssize_t)sizeof(file) &&
+                       read(fd, &extra, 1) == 0 &&
+                       !memcmp(file.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    close(fd);
+    if (!valid || file.state.failingCount > MAX_FAILING_TRIALS) {
+        printf("%s is not a checkpoint of this build.\n", path);
+        return false;
+    }
+    file.state.config[CONFIG_NAME_BYTES - 1] = '\0';
+    *state = file.state;
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+#include "resultsStore.h"
+
+// Periodic checkpoints of a long campaign of trials, so a run that is killed, times out or is
+// preempted by a batch scheduler can be restarted where it stopped rather than from trial 1. The
+// harness runs trials in segments, saving the campaign state between them; only the trials of the
+// segment in flight are lost. Trial randomness is a function of the campaign seed, which is one of
+// the settings, and the trial index (see TrialSeed), so the next index is all the scheduler state a
+// resumed run needs.
+
+// At most this many failing trials are remembered. A campaign stops at its first failure, so more
+// than one means several concurrent trials failed together.
+const uint32_t MAX_FAILING_TRIALS = 64;
+
+struct FailingTrial {
+    uint32_t trial;
+    uint64_t seed;
+};
+
+struct CampaignState {
+    // What the campaign runs, without the host name, so a campaign may resume on another machine.
+    char config[CONFIG_NAME_BYTES] = {};
+    uint32_t batchSize = 0;
+    uint32_t nextTrial = 1;  // 1-based index of the first trial not yet run.
+    uint32_t attempted = 0;
+    uint32_t passed = 0;
+    uint32_t firstFailure = 0;  // As in TrialSummary.
+    double seconds = 0;         // Time spent running trials, summed over every run of the campaign.
+    uint32_t failingCount = 0;
+    FailingTrial failing[MAX_FAILING_TRIALS] = {};
+
+    bool Finished() const { return firstFailure || nextTrial > batchSize; }
+    void AddFailing(uint32_t trial, uint64_t seed);
+};
+
+// Writes state to path through a temporary file and a rename, so a crash mid-write leaves the
+// previous checkpoint intact. Prints the reason and returns false on failure.
+bool SaveCheckpoint(const char* path, const CampaignState& state);
+
+// Prints the reason and returns false if path is missing or not a checkpoint of this build.
+bool LoadCheckpoint(const char* path, CampaignState* state);
+
+// Seconds of trials between checkpoints.
+const uint32_t CHECKPOINT_INTERVAL_S = 30;
+
+// Where the harnesses keep their checkpoint unless told otherwise.
+const char* const CHECKPOINT_PATH = "campaign.ckpt";
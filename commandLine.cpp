@@ -0,0 +1,168 @@
+#include "commandLine.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+const char* const REPORT_FORMAT_NAMES[] = {"text", "json"};
+
+// Column the option descriptions start at in the usage.
+const int HELP_COLUMN = 28;
+
+}  // namespace
+
+const char* ReportFormatName(ReportFormat format) {
+    return REPORT_FORMAT_NAMES[static_cast<int>(format)];
+}
+
+bool ParseReportFormat(const char* name, ReportFormat* out) {
+    for (int i = 0; i < static_cast<int>(ReportFormat::Count); ++i) {
+        if (!strcmp(name, REPORT_FORMAT_NAMES[i])) {
+            *out = static_cast<ReportFormat>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseUint32(const char* arg, uint32_t min, uint32_t max, uint32_t* out) {
+    uint64_t val;
+    if (!ParseUint64(arg, &val) || val < min || val > max) {
+        return false;
+    }
+    *out = static_cast<uint32_t>(val);
+    return true;
+}
+
+bool ParseUint64(const char* arg, uint64_t* out) {
+    char* endptr;
+    errno = 0;
+    // Decimal, or hexadecimal with a 0x prefix; a leading zero does not mean octal.
+    const bool hex = arg[0] == '0' && (arg[1] == 'x' || arg[1] == 'X');
+    const unsigned long long val = strtoull(arg, &endptr, hex ? 16 : 10);
+    if (errno != 0 || endptr == arg || *endptr != '\0' || arg[0] == '-') {
+        return false;
+    }
+    *out = val;
+    return true;
+}
+
+void CommandLine::Add(const char* name, const char* metavar, const std::string& defaultValue,
+                      const char* help, Parser parse, bool positional, bool setting) {
+    options.push_back({name, metavar, help, defaultValue, std::move(parse), nullptr, positional,
+                       setting});
+}
+
+void CommandLine::AddSwitch(const char* name, const char* help, std::function<void()> set) {
+    options.push_back({name, "", help, "", nullptr, std::move(set), false, false});
+}
+
+bool CommandLine::Apply(Option& option, const char* value, bool byName) {
+    // Whichever came last would silently win.
+    if (byName ? option.givenByPosition : option.givenByName) {
+        printf("--%s is given both by position and by name.\n", option.name.c_str());
+        return false;
+    }
+    (byName ? option.givenByName : option.givenByPosition) = true;
+    if (!option.parse(value)) {
+        printf("Invalid value for --%s: %s\n", option.name.c_str(), value);
+        return false;
+    }
+    option.value = value;
+    return true;
+}
+
+bool CommandLine::Parse(int argc, const char* argv[]) {
+    size_t nextPositional = 0;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--", 2)) {
+            while (nextPositional < options.size() && !options[nextPositional].positional) {
+                ++nextPositional;
+            }
+            if (nextPositional == options.size()) {
+                printf("Unexpected argument: %s\n", arg);
+                return false;
+            }
+            if (!Apply(options[nextPositional++], arg, false)) {
+                return false;
+            }
+            continue;
+        }
+
+        const char* equals = strchr(arg, '=');
+        const std::string name(arg + 2, equals ? equals - arg - 2 : strlen(arg + 2));
+        Option* option = nullptr;
+        for (Option& candidate : options) {
+            if (candidate.name == name) {
+                option = &candidate;
+            }
+        }
+        if (!option) {
+            printf("Unknown option: --%s\n", name.c_str());
+            return false;
+        }
+        if (option->set) {
+            if (equals) {
+                printf("--%s takes no value.\n", name.c_str());
+                return false;
+            }
+            option->set();
+            continue;
+        }
+        const char* value = equals ? equals + 1 : i + 1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            printf("--%s needs a value.\n", name.c_str());
+            return false;
+        }
+        if (!Apply(*option, value, true)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CommandLine::SetDefault(const char* name, const std::string& value) {
+    for (Option& option : options) {
+        if (option.name == name && !option.set && !option.givenByPosition &&
+            !option.givenByName && option.parse(value.c_str())) {
+            option.value = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CommandLine::PrintUsage(const char* program) const {
+    printf("Usage: %s", program);
+    for (const Option& option : options) {
+        if (option.positional) {
+            printf(" [%s]", option.name.c_str());
+        }
+    }
+    printf(" [--option=value ...]\n");
+    printf("The bracketed arguments may also be given by name, in any order.\n");
+    for (const Option& option : options) {
+        const std::string flag =
+            "--" + option.name + (option.metavar.empty() ? "" : "=" + option.metavar);
+        printf("  %-*s %s", HELP_COLUMN - 3, flag.c_str(), option.help.c_str());
+        if (!option.set && !option.value.empty()) {
+            printf(" (default %s)", option.value.c_str());
+        }
+        printf("\n");
+    }
+}
+
+std::string CommandLine::Settings() const {
+    std::string settings;
+    for (const Option& option : options) {
+        if (option.setting) {
+            settings += (settings.empty() ? "--" : " --") + option.name + "=" + option.value;
+        }
+    }
+    return settings;
+}
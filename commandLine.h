@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// The option parser both harnesses share. Every option has a name and is given as --name=value or
+// --name value; the options that earlier versions took positionally keep their position, so
+// `./cpuMinRepro 100 0 4` still means --trials=100 --stall-ms=0 --concurrent=4. Each harness
+// registers its own options, since the Metal build links none of the CPU backend's types.
+
+// How a harness prints its final result.
+enum class ReportFormat {
+    Text,
+    Json,  // One JSON object on the last line of stdout.
+    Count,
+};
+
+const char* ReportFormatName(ReportFormat format);
+bool ParseReportFormat(const char* name, ReportFormat* out);
+
+// Parse an unsigned integer, decimal or hexadecimal with a 0x prefix; a leading zero does not mean
+// octal. ParseUint32 also rejects values outside [min, max].
+bool ParseUint32(const char* arg, uint32_t min, uint32_t max, uint32_t* out);
+bool ParseUint64(const char* arg, uint64_t* out);
+
+class CommandLine {
+   public:
+    // Parses a value into the harness's settings; returns false if the value is invalid.
+    using Parser = std::function<bool(const char* value)>;
+
+    // An option that takes a value. defaultValue is shown in the usage and echoed in Settings()
+    // until the option is given. Positional options are filled in the order they are added. A
+    // setting is part of what a trial runs, and so of Settings(); outputs and reporting are not.
+    void Add(const char* name, const char* metavar, const std::string& defaultValue,
+             const char* help, Parser parse, bool positional = false, bool setting = true);
+    // An option without a value.
+    void AddSwitch(const char* name, const char* help, std::function<void()> set);
+
+    // Parses argv, printing what is wrong and returning false on an unknown option, a missing
+    // value, a value the option rejects, too many positional arguments or an option given both
+    // by position and by name.
+    bool Parse(int argc, const char* argv[]);
+    void PrintUsage(const char* program) const;
+
+    // Gives an option that Parse did not set a new default, parsed and echoed in Settings() as
+    // though it had been registered with it, for defaults that depend on other options. Returns
+    // false, leaving the option alone, if it was given or rejects the value.
+    bool SetDefault(const char* name, const std::string& value);
+
+    // Every setting as --name=value, in registration order: the command line that reruns the
+    // same trials.
+    std::string Settings() const;
+
+   private:
+    struct Option {
+        std::string name;
+        std::string metavar;  // Empty for a switch.
+        std::string help;
+        std::string value;
+        Parser parse;
+        std::function<void()> set;
+        bool positional;
+        bool setting;
+        bool givenByPosition = false;
+        bool givenByName = false;
+    };
+
+    bool Apply(Option& option, const char* value, bool byName);
+
+    std::vector<Option> options;
+};
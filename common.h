@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Host-side constants shared by the Metal harness, the CPU backend and the validators.
+// Must exactly match the shader.
+const uint32_t TEST_SIZE = 65535;
+const uint32_t BLOCK_DIM = 32;
+const uint32_t SPLIT_THREADS = 2;
+const uint32_t SPLIT_READY = 3;
+const uint32_t ERROR_TYPE_MESSAGE = 1u;
+const uint32_t ERROR_TYPE_SHUFFLE_READY = 2u;
+const uint32_t ERROR_TYPE_SHUFFLE_INC = 3u;
+const uint32_t ERROR_TYPE_SGSIZE = 4u;
+const uint32_t FLAG_NOT_READY = 0u;
+const uint32_t FLAG_READY = 0x40000000u;
+const uint32_t FLAG_INCLUSIVE = 0x80000000u;
+const uint32_t FLAG_MASK = 0xC0000000u;
+const uint32_t VALUE_MASK = 0xFFFFu;
+
+// Multi-split payloads. A tile's aggregate is splitThreads / 2 independent 32-bit words (for
+// example a sum and a count), each carried as two 16-bit halves by a pair of split lanes: lane tid
+// holds half tid & 1 of word tid / 2. SPLIT_THREADS = 2 is the single u32 the kernel was written
+// for; 4 and 8 lanes carry 64- and 128-bit aggregates.
+const uint32_t MAX_SPLIT_THREADS = 8;
+const uint32_t MAX_AGGREGATE_WORDS = MAX_SPLIT_THREADS / 2;
+
+inline bool IsValidSplitThreads(uint32_t splitThreads) {
+    return splitThreads == 2 || splitThreads == 4 || splitThreads == 8;
+}
+
+// Ballot value when every split lane votes true; SPLIT_READY for two lanes.
+inline uint32_t SplitReady(uint32_t splitThreads) { return (1u << splitThreads) - 1; }
+
+// Word w of every tile's reduction. Word 0 is the original 1024; the others differ so that a lane
+// reading the wrong word is caught.
+inline uint32_t TileWord(uint32_t w) { return 1024u * (w + 1); }
+
+// Layout of the progress buffer polled by the stall monitor. Both counters only ever increase.
+// PROGRESS_INCLUSIVE is a total and names no tile: a tile whose lookback steps past a READY
+// predecessor posts INCLUSIVE before that predecessor does, and the first tile of every chain posts
+// it straight away.
+const uint32_t PROGRESS_INCLUSIVE = 0;
+const uint32_t PROGRESS_POSTED = 1;
+const uint32_t PROGRESS_SIZE = 2;
+
+// Histogram of how many scan buffer polls a tile's lookback made before it could post INCLUSIVE:
+// bucket 0 is a chain root, which never looks back, bucket b holds 2^(b-1) to 2^b - 1 polls, and
+// the last bucket everything above.
+const uint32_t SPIN_BUCKETS = 12;
+
+inline uint32_t SpinBucket(uint32_t polls) {
+    const uint32_t bucket = polls ? 32 - __builtin_clz(polls) : 0;
+    return bucket < SPIN_BUCKETS ? bucket : SPIN_BUCKETS - 1;
+}
+
+// Memory order of the scan buffer loads and stores in the lookback. The values are passed to the
+// stress kernel as the MEMORY_ORDER function constant.
+enum class MemoryOrder : uint32_t {
+    Relaxed = 0,         // Every access relaxed, as the shader was written.
+    AcquireRelease = 1,  // Release stores, acquire loads.
+    SeqCst = 2,          // Sequentially consistent loads and stores.
+    Count,
+};
+
+inline const char* MemoryOrderName(MemoryOrder order) {
+    const char* const names[] = {"relaxed", "acqrel", "seqcst"};
+    return names[static_cast<uint32_t>(order)];
+}
+
+inline bool ParseMemoryOrder(const char* name, MemoryOrder* out) {
+    for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryOrder::Count); ++i) {
+        if (!strcmp(name, MemoryOrderName(static_cast<MemoryOrder>(i)))) {
+            *out = static_cast<MemoryOrder>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Which algorithm fills the scan buffer. Both leave it in the same final state, so the same
+// validation applies.
+enum class ScanAlgorithm : uint32_t {
+    Chained = 0,         // The stress kernel: single pass, chained lookback.
+    ReduceThenScan = 1,  // Three passes with no inter-workgroup waiting: reduce, scan, downsweep.
+    Count,
+};
+
+inline const char* ScanAlgorithmName(ScanAlgorithm algorithm) {
+    const char* const names[] = {"chained", "rts"};
+    return names[static_cast<uint32_t>(algorithm)];
+}
+
+inline bool ParseScanAlgorithm(const char* name, ScanAlgorithm* out) {
+    for (uint32_t i = 0; i < static_cast<uint32_t>(ScanAlgorithm::Count); ++i) {
+        if (!strcmp(name, ScanAlgorithmName(static_cast<ScanAlgorithm>(i)))) {
+            *out = static_cast<ScanAlgorithm>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Load a co-runner generates alongside the trials, to reproduce the contention under which the
+// lookback starves. See noiseWorkload.h for the CPU backend and noiseShader.metal for Metal.
+enum class NoiseKind : uint32_t {
+    None = 0,
+    Memory = 1,   // Streams read-modify-writes through a buffer far larger than the caches.
+    Atomic = 2,   // Every noise thread hammers atomic adds on one shared cache line.
+    Compute = 3,  // Dependent arithmetic in registers; takes execution slots, not memory.
+    Count,
+};
+
+inline const char* NoiseKindName(NoiseKind kind) {
+    const char* const names[] = {"none", "memory", "atomic", "compute"};
+    return names[static_cast<uint32_t>(kind)];
+}
+
+inline bool ParseNoiseKind(const char* name, NoiseKind* out) {
+    for (uint32_t i = 0; i < static_cast<uint32_t>(NoiseKind::Count); ++i) {
+        if (!strcmp(name, NoiseKindName(static_cast<NoiseKind>(i)))) {
+            *out = static_cast<NoiseKind>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Hardware events the CPU harness counts with perf_event_open; see perfCounters.h. Here rather
+// than there because every TrialRecord has a column per event, in the Metal harness's stores too.
+enum class PerfEvent : uint32_t {
+    Cycles,
+    Instructions,
+    CacheMisses,    // Last-level misses: lines that had to come from memory or another socket.
+    L1dReadMisses,  // Includes lines stolen by another core's store, i.e. coherence misses.
+    BackendStalls,  // Cycles the back end was stalled, mostly on memory: waiting, not spinning.
+    NodeMisses,     // Loads served from another NUMA node's memory or caches.
+    Count,
+};
+
+inline const char* PerfEventName(PerfEvent event) {
+    const char* const names[] = {"cycles",     "instructions",   "llc-misses",
+                                 "l1d-misses", "backend-stalls", "node-misses"};
+    return names[static_cast<uint32_t>(event)];
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "chainedScan.h"
+
+// Stable stream compaction (filter) in a single pass over the input, chained like the stress
+// kernel. Each tile evaluates the predicate 32 elements at a time into a ballot mask, posts its
+// survivor count, looks back for the number of survivors in all preceding tiles and scatters its
+// survivors from there. The predicate is a template parameter so it inlines into the ballot loop.
+class CpuCompact {
+   public:
+    explicit CpuCompact(uint32_t workerCount, WaitPolicy waitPolicy = WaitPolicy::Pause)
+        : workerCount(workerCount ? workerCount : 1), waitPolicy(waitPolicy) {}
+
+    // Writes every in[i] with pred(in[i]) to out, in order, and returns how many there were. out
+    // must have room for n elements; n must be below 2^30.
+    template <typename Pred>
+    size_t Compact(const uint32_t* in, size_t n, uint32_t* out, const Pred& pred);
+
+    // The two-pass baseline: count survivors per chunk, scan the counts, then re-read the input
+    // and scatter. Same contract as Compact.
+    template <typename Pred>
+    size_t CompactTwoPass(const uint32_t* in, size_t n, uint32_t* out, const Pred& pred);
+
+    static const uint32_t TILE_ELEMENTS = 8192;
+    static const uint32_t BALLOT_WIDTH = 32;
+
+   private:
+    uint32_t workerCount;
+    WaitPolicy waitPolicy;
+    ParkingLot lot;
+    std::atomic<uint32_t> tileBump{0};
+    std::unique_ptr<std::atomic<uint32_t>[]> status;
+    size_t statusWords = 0;
+};
+
+template <typename Pred>
+size_t CpuCompact::Compact(const uint32_t* in, size_t n, uint32_t* out, const Pred& pred) {
+    assert(n < MAX_CHAINED_ELEMENTS && "a survivor count must fit in a status word");
+    const uint32_t tiles = (uint32_t)((n + TILE_ELEMENTS - 1) / TILE_ELEMENTS);
+    if (tiles > statusWords) {
+        statusWords = tiles;
+        status.reset(new std::atomic<uint32_t>[statusWords]);
+    }
+    for (uint32_t t = 0; t < tiles; ++t) {
+        status[t].store(FLAG_NOT_READY, std::memory_order_relaxed);
+    }
+    tileBump.store(0, std::memory_order_relaxed);
+
+    std::atomic<size_t> total{0};
+    RunWorkers(std::max(1u, std::min(workerCount, tiles)), [&](uint32_t) {
+        uint32_t masks[TILE_ELEMENTS / BALLOT_WIDTH];
+        while (true) {
+            const uint32_t tile = tileBump.fetch_add(1u, std::memory_order_relaxed);
+            if (tile >= tiles) {
+                break;
+            }
+            const size_t begin = size_t(tile) * TILE_ELEMENTS;
+            const size_t end = std::min(n, begin + TILE_ELEMENTS);
+
+            // Ballot: one bit per element, 32 elements per mask, counted with popcount.
+            uint32_t count = 0;
+            uint32_t groups = 0;
+            for (size_t base = begin; base < end; base += BALLOT_WIDTH, ++groups) {
+                const uint32_t lanes = (uint32_t)std::min<size_t>(BALLOT_WIDTH, end - base);
+                uint32_t mask = 0;
+                for (uint32_t lane = 0; lane < lanes; ++lane) {
+                    mask |= (pred(in[base + lane]) ? 1u : 0u) << lane;
+                }
+                masks[groups] = mask;
+                count += __builtin_popcount(mask);
+            }
+
+            PostTileCount(status[tile], tile, count, waitPolicy, lot);
+            size_t dst = LookbackTileCount(status.get(), 1, tile, count, waitPolicy, lot);
+            if (tile == tiles - 1) {
+                total.store(dst + count, std::memory_order_relaxed);
+            }
+
+            for (uint32_t g = 0; g < groups; ++g) {
+                const size_t base = begin + size_t(g) * BALLOT_WIDTH;
+                for (uint32_t mask = masks[g]; mask; mask &= mask - 1) {
+                    out[dst++] = in[base + __builtin_ctz(mask)];
+                }
+            }
+        }
+    });
+    return total.load();
+}
+
+template <typename Pred>
+size_t CpuCompact::CompactTwoPass(const uint32_t* in, size_t n, uint32_t* out, const Pred& pred) {
+    assert(n < MAX_CHAINED_ELEMENTS && "same contract as Compact");
+    const size_t chunk = (n + workerCount - 1) / workerCount;
+    std::vector<size_t> offsets(workerCount + 1, 0);
+    RunWorkers(workerCount, [&](uint32_t w) {
+        const size_t end = std::min(n, (w + 1) * chunk);
+        size_t count = 0;
+        for (size_t i = w * chunk; i < end; ++i) {
+            count += pred(in[i]) ? 1 : 0;
+        }
+        offsets[w + 1] = count;
+    });
+    for (uint32_t w = 0; w < workerCount; ++w) {
+        offsets[w + 1] += offsets[w];
+    }
+    RunWorkers(workerCount, [&](uint32_t w) {
+        const size_t end = std::min(n, (w + 1) * chunk);
+        size_t dst = offsets[w];
+        for (size_t i = w * chunk; i < end; ++i) {
+            if (pred(in[i])) {
+                out[dst++] = in[i];
+            }
+        }
+    });
+    return offsets[workerCount];
+}
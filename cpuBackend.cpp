@@ -0,0 +1,726 @@
+#include "cpuBackend.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "stallMonitor.h"
+
+namespace {
+
+// A tile's aggregate: splitThreads / 2 independent words, the rest zero.
+using Aggregate = std::array<uint32_t, MAX_AGGREGATE_WORDS>;
+
+// Mirrors split() in the shader: the half of an aggregate that lane tid carries.
+uint32_t Split(const Aggregate& x, uint32_t tid) {
+    return x[tid / 2] >> (tid & 1) * 16 & VALUE_MASK;
+}
+
+// Mirrors gather() in the shader. Every lane assembles the whole aggregate from the halves of all
+// n split lanes. The lanes run in lockstep on one thread, so each shuffle is a read of another
+// lane's register, and the result is the same for every lane.
+Aggregate Gather(const uint32_t (&value)[MAX_SPLIT_THREADS], uint32_t n) {
+    Aggregate agg = {};
+    for (uint32_t lane = 0; lane < n; ++lane) {
+        agg[lane / 2] |= value[lane] << 16 * (lane & 1);
+    }
+    return agg;
+}
+
+// Mirrors ballot() in the shader, restricted to the n split lanes.
+uint32_t Ballot(const bool (&pred)[MAX_SPLIT_THREADS], uint32_t n) {
+    uint32_t bits = 0;
+    for (uint32_t tid = 0; tid < n; ++tid) {
+        bits |= (pred[tid] ? 1u : 0u) << tid;
+    }
+    return bits;
+}
+
+// The reduction of `tiles` tiles.
+Aggregate TileAggregate(uint32_t tiles, uint32_t n) {
+    Aggregate agg = {};
+    for (uint32_t w = 0; w < n / 2; ++w) {
+        agg[w] = TileWord(w) * tiles;
+    }
+    return agg;
+}
+
+Aggregate Add(Aggregate a, const Aggregate& b) {
+    for (uint32_t w = 0; w < MAX_AGGREGATE_WORDS; ++w) {
+        a[w] += b[w];
+    }
+    return a;
+}
+
+const char* const SCAN_LAYOUT_NAMES[] = {"packed", "padded", "soa"};
+const char* const SCHEDULER_POLICY_NAMES[] = {"fair", "yield", "preempt"};
+
+// How long SchedulerPolicy::Preempt takes a worker off its core.
+const uint32_t PREEMPT_US = 200;
+
+uint32_t ScanWords(ScanLayout layout, uint32_t splitThreads) {
+    return layout == ScanLayout::Padded ? TEST_SIZE * CACHE_LINE_WORDS : TEST_SIZE * splitThreads;
+}
+
+constexpr std::memory_order LoadOrder(MemoryOrder order) {
+    switch (order) {
+        case MemoryOrder::AcquireRelease:
+            return std::memory_order_acquire;
+        case MemoryOrder::SeqCst:
+            return std::memory_order_seq_cst;
+        default:
+            return std::memory_order_relaxed;
+    }
+}
+
+constexpr std::memory_order StoreOrder(MemoryOrder order) {
+    switch (order) {
+        case MemoryOrder::AcquireRelease:
+            return std::memory_order_release;
+        case MemoryOrder::SeqCst:
+            return std::memory_order_seq_cst;
+        default:
+            return std::memory_order_relaxed;
+    }
+}
+
+CpuConfig Normalized(CpuConfig config) {
+    config.workerCount = config.workerCount ? config.workerCount : 1;
+    config.tileCount = std::min(std::max(config.tileCount, 1u), TEST_SIZE);
+    config.tilesPerScan = std::min(std::max(config.tilesPerScan, 1u), TEST_SIZE);
+    if (!IsValidSplitThreads(config.splitThreads)) {
+        config.splitThreads = SPLIT_THREADS;
+    }
+    return config;
+}
+
+// The buffers the validators can read in place. A packed scan buffer of atomics has exactly the
+// representation of the plain words the validators take; the other layouts must be gathered.
+uint32_t HostVisibleBuffers(const CpuConfig& config) {
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+                      std::atomic<uint32_t>::is_always_lock_free,
+                  "the packed scan buffer is read in place as uint32_t");
+    if (!config.zeroCopy) {
+        return 0;
+    }
+    const uint32_t scan = config.layout == ScanLayout::Packed ? BufferBit(GraphBuffer::Scan) : 0;
+    return scan | BufferBit(GraphBuffer::Errors);
+}
+
+// The options of one stress kernel instantiation, fixed at compile time. Every accessor is a
+// constant expression, so each instantiation of StressTile is straight-line code for its variant:
+// the lane loops unroll, the layout and memory order are folded into each access, and a disabled
+// feature (checks, parking, the wait itself under Spin) leaves no instruction behind.
+template <ScanLayout L, MemoryOrder O, uint32_t N, WaitPolicy W, bool CHECKS>
+struct StaticVariant {
+    explicit StaticVariant(const CpuConfig&) {}
+    static constexpr ScanLayout Layout() { return L; }
+    static constexpr std::memory_order LoadOrder() { return ::LoadOrder(O); }
+    static constexpr std::memory_order StoreOrder() { return ::StoreOrder(O); }
+    static constexpr uint32_t SplitThreads() { return N; }
+    static constexpr WaitPolicy Wait() { return W; }
+    static constexpr bool Checks() { return CHECKS; }
+};
+
+// The same options read from the configuration at run time: one generic instantiation that pays a
+// branch for every option, kept as the baseline the specializations are measured against.
+struct DynamicVariant {
+    explicit DynamicVariant(const CpuConfig& config) : config(config) {}
+    ScanLayout Layout() const { return config.layout; }
+    std::memory_order LoadOrder() const { return ::LoadOrder(config.memoryOrder); }
+    std::memory_order StoreOrder() const { return ::StoreOrder(config.memoryOrder); }
+    uint32_t SplitThreads() const { return config.splitThreads; }
+    WaitPolicy Wait() const { return config.waitPolicy; }
+    bool Checks() const { return config.checks; }
+    const CpuConfig& config;
+};
+
+// The registry is indexed by the options in this order, checks varying fastest.
+const uint32_t SPLIT_WIDTHS = 3;  // 2, 4 and 8 lanes.
+const uint32_t VARIANT_COUNT = static_cast<uint32_t>(ScanLayout::Count) *
+                               static_cast<uint32_t>(MemoryOrder::Count) * SPLIT_WIDTHS *
+                               static_cast<uint32_t>(WaitPolicy::Count) * 2;
+
+uint32_t SplitWidthIndex(uint32_t splitThreads) {
+    return splitThreads == 8 ? 2 : splitThreads == 4 ? 1 : 0;
+}
+
+uint32_t VariantIndex(const CpuConfig& config) {
+    uint32_t index = static_cast<uint32_t>(config.layout);
+    index = index * static_cast<uint32_t>(MemoryOrder::Count) +
+            static_cast<uint32_t>(config.memoryOrder);
+    index = index * SPLIT_WIDTHS + SplitWidthIndex(config.splitThreads);
+    index = index * static_cast<uint32_t>(WaitPolicy::Count) +
+            static_cast<uint32_t>(config.waitPolicy);
+    return index * 2 + (config.checks ? 1 : 0);
+}
+
+// The instantiation at registry index I; the inverse of VariantIndex.
+template <size_t I>
+struct VariantAt {
+    static constexpr size_t WAIT_COUNT = static_cast<size_t>(WaitPolicy::Count);
+    static constexpr size_t ORDER_COUNT = static_cast<size_t>(MemoryOrder::Count);
+    using Type = StaticVariant<
+        static_cast<ScanLayout>(I / 2 / WAIT_COUNT / SPLIT_WIDTHS / ORDER_COUNT),
+        static_cast<MemoryOrder>(I / 2 / WAIT_COUNT / SPLIT_WIDTHS % ORDER_COUNT),
+        2u << (I / 2 / WAIT_COUNT % SPLIT_WIDTHS), static_cast<WaitPolicy>(I / 2 % WAIT_COUNT),
+        I % 2 != 0>;
+};
+
+}  // namespace
+
+std::string VariantName(const CpuConfig& config) {
+    if (!config.specialized) {
+        return "dynamic";
+    }
+    return std::string(ScanLayoutName(config.layout)) + "/" +
+           MemoryOrderName(config.memoryOrder) + "/x" + std::to_string(config.splitThreads) + "/" +
+           WaitPolicyName(config.waitPolicy) + "/" + (config.checks ? "checked" : "unchecked");
+}
+
+std::vector<std::string> CompiledVariantNames() {
+    std::vector<std::string> names;
+    for (uint32_t index = 0; index < VARIANT_COUNT; ++index) {
+        // Decodes index as VariantIndex encodes it.
+        CpuConfig config;
+        uint32_t rest = index;
+        config.checks = rest % 2 != 0;
+        rest /= 2;
+        config.waitPolicy =
+            static_cast<WaitPolicy>(rest % static_cast<uint32_t>(WaitPolicy::Count));
+        rest /= static_cast<uint32_t>(WaitPolicy::Count);
+        config.splitThreads = 2u << (rest % SPLIT_WIDTHS);
+        rest /= SPLIT_WIDTHS;
+        config.memoryOrder =
+            static_cast<MemoryOrder>(rest % static_cast<uint32_t>(MemoryOrder::Count));
+        config.layout = static_cast<ScanLayout>(rest / static_cast<uint32_t>(MemoryOrder::Count));
+        names.push_back(VariantName(config));
+    }
+    return names;
+}
+
+const char* ScanLayoutName(ScanLayout layout) {
+    return SCAN_LAYOUT_NAMES[static_cast<int>(layout)];
+}
+
+bool ParseScanLayout(const char* name, ScanLayout* out) {
+    for (int i = 0; i < static_cast<int>(ScanLayout::Count); ++i) {
+        if (!strcmp(name, SCAN_LAYOUT_NAMES[i])) {
+            *out = static_cast<ScanLayout>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* SchedulerPolicyName(SchedulerPolicy policy) {
+    return SCHEDULER_POLICY_NAMES[static_cast<int>(policy)];
+}
+
+bool ParseSchedulerPolicy(const char* name, SchedulerPolicy* out) {
+    for (int i = 0; i < static_cast<int>(SchedulerPolicy::Count); ++i) {
+        if (!strcmp(name, SCHEDULER_POLICY_NAMES[i])) {
+            *out = static_cast<SchedulerPolicy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+CpuBackend::CpuBackend(const CpuConfig& cfg)
+    : config(Normalized(cfg)),
+      graph(GraphOptions{config.algorithm, config.checks, HostVisibleBuffers(config),
+                         config.tileCount}),
+      stressTile(SelectKernel(config)),
+      scanWords(ScanWords(config.layout, config.splitThreads)),
+      scan(new (std::align_val_t(64)) std::atomic<uint32_t>[scanWords]),
+      errors(TEST_SIZE * config.splitThreads * 2),
+      allocator(config.allocation, config.workerCount),
+      workers(new WorkerState[config.workerCount]),
+      workerCpus(PlaceWorkers(config.placement, config.workerCount, config.placementSlot)) {
+    // The buffers go to the node of the first worker, which holds the head of the chain; under
+    // Socket that is every worker's node.
+    if (!workerCpus.empty()) {
+        const uint32_t node = workerCpus[0].node;
+        BindToNode(scan.get(), scanWords * sizeof(scan[0]), node);
+        BindToNode(errors.data(), errors.size() * sizeof(errors[0]), node);
+        BindToNode(workers.get(), config.workerCount * sizeof(WorkerState), node);
+    }
+}
+
+void CpuBackend::Init() {
+    allocator.Reset();
+    for (uint32_t i = 0; i < scanWords; ++i) {
+        scan[i].store(0, std::memory_order_relaxed);
+    }
+    // Production mode never posts an error, so the error buffer stays zero from construction.
+    if (config.checks) {
+        std::fill(errors.begin(), errors.end(), 0);
+    }
+    for (auto& counter : progress) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (uint32_t w = 0; w < config.workerCount; ++w) {
+        std::fill(std::begin(workers[w].spins), std::end(workers[w].spins), 0);
+    }
+}
+
+void CpuBackend::SeedTrial(uint64_t seed) {
+    for (uint32_t w = 0; w < config.workerCount; ++w) {
+        // Never zero, which MaybeDeschedule takes as unseeded.
+        workers[w].rng = ((uint32_t)(seed ^ (seed >> 32)) ^ w * 0x9E3779B9u) | 1u;
+    }
+}
+
+void CpuBackend::SpinHistogram(uint32_t* out) const {
+    std::fill(out, out + SPIN_BUCKETS, 0);
+    for (uint32_t w = 0; w < config.workerCount; ++w) {
+        for (uint32_t b = 0; b < SPIN_BUCKETS; ++b) {
+            out[b] += workers[w].spins[b];
+        }
+    }
+}
+
+void CpuBackend::DispatchKernels(uint32_t stallIntervalMs, PerfCounters* counters) {
+    bool counting = false;
+    for (uint32_t i = 0; i < graph.StageCount(); ++i) {
+        if (graph.Stage(i).queue != StageQueue::Compute) {
+            continue;
+        }
+        if (counters && !counting && graph.Stage(i).kind != StageKind::Init) {
+            counters->Start();
+            counting = true;
+        }
+        RunComputeStage(graph.Stage(i).kind, stallIntervalMs);
+    }
+    if (counting) {
+        counters->Stop();
+    }
+}
+
+void CpuBackend::RunComputeStage(StageKind kind, uint32_t stallIntervalMs) {
+    switch (kind) {
+        case StageKind::Init:
+            Init();
+            break;
+        case StageKind::Stress:
+            monitored = stallIntervalMs != 0;
+            Launch(
+                [this](WorkerState& state) {
+                    ForEachTile(state, [this, &state](uint32_t tileId) {
+                        (this->*stressTile)(tileId, state);
+                    });
+                },
+                stallIntervalMs);
+            break;
+        case StageKind::Reduce:
+            Reduce();
+            break;
+        case StageKind::ScanReductions:
+            ScanReductions();
+            break;
+        case StageKind::Downsweep:
+            Downsweep();
+            break;
+        default:
+            break;
+    }
+}
+
+TrialVerdict CpuBackend::RunTrial(uint32_t stallIntervalMs, FailureList* failures) {
+    DispatchKernels(stallIntervalMs);
+    CopyToHost();
+    return RunHostStages(
+        graph, [this](GraphBuffer buffer) { return HostBuffer(buffer); }, config.tilesPerScan,
+        config.splitThreads, failures);
+}
+
+void CpuBackend::Launch(const std::function<void(WorkerState&)>& worker,
+                        uint32_t stallIntervalMs) {
+    // A lone unmonitored worker runs the tiles in order on the calling thread; there is nothing to
+    // overlap with, so spawning would only add latency to every trial. A pinned one still gets a
+    // thread, so the caller stays unpinned.
+    if (config.workerCount == 1 && !stallIntervalMs && workerCpus.empty()) {
+        worker(workers[0]);
+        return;
+    }
+
+    std::atomic<uint32_t> running{config.workerCount};
+    std::vector<std::thread> threads;
+    threads.reserve(config.workerCount);
+    for (uint32_t w = 0; w < config.workerCount; ++w) {
+        threads.emplace_back([this, w, &worker, &running] {
+            if (!workerCpus.empty()) {
+                PinThread(workerCpus[w].cpu);
+            }
+            worker(workers[w]);
+            running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    if (stallIntervalMs) {
+        StallMonitor monitor(stallIntervalMs, config.tileCount);
+        while (running.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(monitor.PollPeriod());
+            const ProgressSnapshot snapshot = {
+                progress[PROGRESS_INCLUSIVE].load(std::memory_order_relaxed),
+                progress[PROGRESS_POSTED].load(std::memory_order_relaxed)};
+            if (monitor.Observe(snapshot)) {
+                PrintStallReport(snapshot, stallIntervalMs, config.tileCount);
+                ReportStall();
+            }
+        }
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void CpuBackend::ReportStall() {
+    // The scan buffer is host memory, so the lowest unfinished tile is read from it directly. The
+    // INCLUSIVE count cannot name it: a tile that found an INCLUSIVE tile further back posts
+    // INCLUSIVE while its predecessor may still be READY.
+    uint32_t blocking = 0;
+    for (; blocking < config.tileCount; ++blocking) {
+        bool inclusive = true;
+        for (uint32_t tid = 0; tid < config.splitThreads; ++tid) {
+            inclusive = inclusive && (Scan(blocking, tid).load(std::memory_order_relaxed) &
+                                      FLAG_MASK) == FLAG_INCLUSIVE;
+        }
+        if (!inclusive) {
+            break;
+        }
+    }
+    printf("  Lowest unfinished (blocking) tile: %u\n", blocking);
+    const uint32_t bump = allocator.Allocated();
+    printf("  scan_bump: %u\n", bump);
+    const uint32_t first = blocking ? blocking - 1 : 0;
+    for (uint32_t tile = first; tile <= blocking && tile < config.tileCount; ++tile) {
+        for (uint32_t w = 0; w < config.splitThreads / 2; ++w) {
+            const uint32_t lo = Scan(tile, w * 2).load(std::memory_order_relaxed);
+            const uint32_t hi = Scan(tile, w * 2 + 1).load(std::memory_order_relaxed);
+            printf("  scan[%u] word %u = {0x%08X, 0x%08X} (flags: 0x%x, 0x%x, value: %u)\n", tile,
+                   w, lo, hi, lo & FLAG_MASK, hi & FLAG_MASK,
+                   (lo & VALUE_MASK) | (hi & VALUE_MASK) << 16);
+        }
+    }
+    bool owned = false;
+    for (uint32_t w = 0; w < config.workerCount; ++w) {
+        if (workers[w].tileId.load(std::memory_order_relaxed) == blocking) {
+            printf("  Blocking tile %u is held by worker %u, looking back at tile %u.\n", blocking,
+                   w, workers[w].lookbackId.load(std::memory_order_relaxed));
+            owned = true;
+        }
+    }
+    if (!owned) {
+        printf("  Blocking tile %u is not held by any worker (%s).\n", blocking,
+               blocking < bump ? "finished, between tiles or granted but not started"
+                               : "not yet allocated");
+    }
+}
+
+void CpuBackend::ForEachTile(WorkerState& state, const std::function<void(uint32_t)>& body) {
+    const uint32_t workerIndex = static_cast<uint32_t>(&state - &workers[0]);
+    state.cursor = {};
+    while (true) {
+        const uint32_t tileId = allocator.Next(workerIndex, state.cursor, config.tileCount);
+        if (tileId >= config.tileCount) {
+            break;
+        }
+        state.tileId.store(tileId, std::memory_order_relaxed);
+        body(tileId);
+    }
+    state.tileId.store(TEST_SIZE, std::memory_order_relaxed);
+}
+
+void CpuBackend::MaybeDeschedule(WorkerState& state) {
+    switch (config.scheduler) {
+        case SchedulerPolicy::Yield:
+            std::this_thread::yield();
+            break;
+        case SchedulerPolicy::Preempt:
+            // xorshift32, seeded per worker on first use.
+            state.rng = state.rng ? state.rng : 0x9E3779B9u ^ (uint32_t)(&state - &workers[0]);
+            state.rng ^= state.rng << 13;
+            state.rng ^= state.rng >> 17;
+            state.rng ^= state.rng << 5;
+            if ((state.rng & 0xFF) == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(PREEMPT_US));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// The baseline that needs no inter-workgroup communication, as three dispatches over the same
+// buffers. The reduce phase leaves word w of each tile's full reduction in its lane w entry, the
+// scan phase turns those into exclusive prefixes in place (restarting at every chain root), and the
+// downsweep adds the tile's own reduction back and posts the split INCLUSIVE result the validators
+// expect. The data is constant, so a tile's reduction is TileAggregate(1).
+void CpuBackend::Reduce() {
+    const uint32_t n = config.splitThreads;
+    const Aggregate tile = TileAggregate(1, n);
+    Launch(
+        [this, n, &tile](WorkerState& state) {
+            ForEachTile(state, [this, n, &tile, &state](uint32_t tileId) {
+                for (uint32_t w = 0; w < n / 2; ++w) {
+                    Scan(tileId, w).store(tile[w], std::memory_order_relaxed);
+                }
+                MaybeDeschedule(state);
+            });
+        },
+        0);
+}
+
+void CpuBackend::ScanReductions() {
+    const uint32_t n = config.splitThreads;
+    Aggregate sum = {};
+    for (uint32_t tileId = 0; tileId < config.tileCount; ++tileId) {
+        if (tileId % config.tilesPerScan == 0) {
+            sum = {};
+        }
+        for (uint32_t w = 0; w < n / 2; ++w) {
+            const uint32_t reduction = Scan(tileId, w).load(std::memory_order_relaxed);
+            Scan(tileId, w).store(sum[w], std::memory_order_relaxed);
+            sum[w] += reduction;
+        }
+    }
+}
+
+void CpuBackend::Downsweep() {
+    const uint32_t n = config.splitThreads;
+    const Aggregate tile = TileAggregate(1, n);
+    // Each pass is its own dispatch, with tile IDs handed out from zero again.
+    allocator.Reset();
+    Launch(
+        [this, n, &tile](WorkerState& state) {
+            ForEachTile(state, [this, n, &tile, &state](uint32_t tileId) {
+                Aggregate inclusive = {};
+                for (uint32_t w = 0; w < n / 2; ++w) {
+                    inclusive[w] = Scan(tileId, w).load(std::memory_order_relaxed) + tile[w];
+                }
+                for (uint32_t tid = 0; tid < n; ++tid) {
+                    Scan(tileId, tid).store(Split(inclusive, tid) | FLAG_INCLUSIVE,
+                                            std::memory_order_relaxed);
+                }
+                MaybeDeschedule(state);
+            });
+        },
+        0);
+}
+
+// Mirrors the stress kernel in stressShader.metal, including its validation checks; see there for
+// the full description of the protocol. Every kernel option comes from V.
+template <class V>
+void CpuBackend::StressTile(uint32_t tileId, WorkerState& state) {
+    const V v(config);
+    const uint32_t n = v.SplitThreads();
+    auto scanAt = [&](uint32_t tile, uint32_t tid) -> std::atomic<uint32_t>& {
+        return scan[ScanLayoutIndex(v.Layout(), n, tile, tid)];
+    };
+    auto wake = [&](uint32_t tile, uint32_t tid) {
+        if (v.Wait() == WaitPolicy::Park) {
+            WakeWaiters(WaitPolicy::Park, lot, scanAt(tile, tid));
+        }
+    };
+    const uint32_t splitReady = SplitReady(n);
+    uint32_t (*const err)[2] = reinterpret_cast<uint32_t (*)[2]>(&errors[tileId * n * 2]);
+    // Position within this tile's chain. The first tile of every chain is its root, so a lookback
+    // always ends at or before it and never crosses into the previous scan.
+    const uint32_t chainTile = tileId % config.tilesPerScan;
+    const uint32_t chainBase = tileId - chainTile;
+    const Aggregate tile = TileAggregate(1, n);
+
+    for (uint32_t tid = 0; tid < n; ++tid) {
+        const uint32_t t = Split(tile, tid) | (chainTile == 0 ? FLAG_INCLUSIVE : FLAG_READY);
+        scanAt(tileId, tid).store(t, v.StoreOrder());
+        wake(tileId, tid);
+    }
+    if (monitored) {
+        progress[PROGRESS_POSTED].fetch_add(1u, std::memory_order_relaxed);
+    }
+    if (chainTile == 0) {
+        if (monitored) {
+            progress[PROGRESS_INCLUSIVE].fetch_add(1u, std::memory_order_relaxed);
+        }
+        state.spins[0]++;
+        return;
+    }
+    // The window in which a descheduled predecessor holds up every successor.
+    MaybeDeschedule(state);
+
+    Aggregate prevRed[MAX_SPLIT_THREADS] = {};
+    uint32_t flagPayload[MAX_SPLIT_THREADS];
+    uint32_t value[MAX_SPLIT_THREADS];
+    bool pred[MAX_SPLIT_THREADS];
+    bool errEncountered[MAX_SPLIT_THREADS] = {};
+    uint32_t lookbackId = tileId - 1;
+    uint32_t polls = 0;
+    Waiter waiter(v.Wait(), lot);
+
+    auto load = [&] {
+        ++polls;
+        for (uint32_t tid = 0; tid < n; ++tid) {
+            flagPayload[tid] = scanAt(lookbackId, tid).load(v.LoadOrder());
+        }
+    };
+    // Waits on the first lane whose entry has not yet reached the state the loop is waiting for.
+    // Spin re-polls immediately, so it never touches the waiter.
+    auto wait = [&](Waiter& w) {
+        if (v.Wait() == WaitPolicy::Spin) {
+            return;
+        }
+        for (uint32_t tid = 0; tid < n; ++tid) {
+            if (!pred[tid]) {
+                w.Wait(scanAt(lookbackId, tid), flagPayload[tid]);
+                return;
+            }
+        }
+    };
+    auto postError = [&](uint32_t tid, uint32_t type, uint32_t got) {
+        err[tid][0] = type;
+        err[tid][1] = got;
+        errEncountered[tid] = true;
+    };
+    auto messagePassingCheck = [&] {
+        if (!v.Checks()) {
+            return;
+        }
+        const Aggregate inclusive = TileAggregate(lookbackId - chainBase + 1, n);
+        for (uint32_t tid = 0; tid < n; ++tid) {
+            const uint32_t p = flagPayload[tid];
+            if (!errEncountered[tid] && p != FLAG_NOT_READY &&
+                p != (Split(tile, tid) | FLAG_READY) &&
+                p != (Split(inclusive, tid) | FLAG_INCLUSIVE)) {
+                postError(tid, ERROR_TYPE_MESSAGE, p);
+            }
+        }
+    };
+    // Gathers the aggregate into every lane's running reduction and checks it against expected;
+    // a lane posts the first word that is wrong.
+    auto gatherInto = [&](const Aggregate& expected, uint32_t errType) {
+        for (uint32_t tid = 0; tid < n; ++tid) {
+            value[tid] = flagPayload[tid] & VALUE_MASK;
+        }
+        const Aggregate gathered = Gather(value, n);
+        for (uint32_t tid = 0; tid < n; ++tid) {
+            prevRed[tid] = Add(prevRed[tid], gathered);
+            for (uint32_t w = 0; w < n / 2 && v.Checks() && !errEncountered[tid]; ++w) {
+                if (prevRed[tid][w] != expected[w]) {
+                    postError(tid, errType, prevRed[tid][w]);
+                }
+            }
+        }
+    };
+
+    while (true) {
+        state.lookbackId.store(lookbackId, std::memory_order_relaxed);
+        load();
+        messagePassingCheck();
+
+        for (uint32_t tid = 0; tid < n; ++tid) {
+            pred[tid] = (flagPayload[tid] & FLAG_MASK) > FLAG_NOT_READY;
+        }
+        if (Ballot(pred, n) != splitReady) {
+            wait(waiter);
+            continue;
+        }
+
+        for (uint32_t tid = 0; tid < n; ++tid) {
+            pred[tid] = (flagPayload[tid] & FLAG_MASK) == FLAG_INCLUSIVE;
+        }
+        uint32_t incBal = Ballot(pred, n);
+        if (incBal != 0) {
+            // One lane saw INCLUSIVE, so wait until every other lane does too.
+            Waiter pairWaiter(v.Wait(), lot);
+            while (incBal != splitReady) {
+                wait(pairWaiter);
+                load();
+                for (uint32_t tid = 0; tid < n; ++tid) {
+                    pred[tid] = (flagPayload[tid] & FLAG_MASK) == FLAG_INCLUSIVE;
+                }
+                incBal = Ballot(pred, n);
+            }
+            messagePassingCheck();
+            gatherInto(TileAggregate(chainTile, n), ERROR_TYPE_SHUFFLE_INC);
+
+            for (uint32_t tid = 0; tid < n; ++tid) {
+                const uint32_t t = Split(Add(prevRed[tid], tile), tid) | FLAG_INCLUSIVE;
+                scanAt(tileId, tid).store(t, v.StoreOrder());
+                wake(tileId, tid);
+            }
+            if (monitored) {
+                progress[PROGRESS_INCLUSIVE].fetch_add(1u, std::memory_order_relaxed);
+            }
+            state.spins[SpinBucket(polls)]++;
+            break;
+        } else {
+            gatherInto(TileAggregate(tileId - lookbackId, n), ERROR_TYPE_SHUFFLE_READY);
+            lookbackId -= 1;
+            waiter.Reset();
+        }
+    }
+}
+
+template <size_t... I>
+const CpuBackend::TileKernel* CpuBackend::KernelTable(std::index_sequence<I...>) {
+    static const TileKernel table[] = {&CpuBackend::StressTile<typename VariantAt<I>::Type>...};
+    return table;
+}
+
+CpuBackend::TileKernel CpuBackend::SelectKernel(const CpuConfig& config) {
+    if (!config.specialized) {
+        return &CpuBackend::StressTile<DynamicVariant>;
+    }
+    return KernelTable(std::make_index_sequence<VARIANT_COUNT>())[VariantIndex(config)];
+}
+
+const void* CpuBackend::KernelEntry(const CpuConfig& config) {
+    // Under the Itanium C++ ABI, which every compiler this builds with follows, a pointer to a
+    // non-virtual member function starts with the function's address.
+    const TileKernel kernel = SelectKernel(config);
+    const void* entry;
+    memcpy(&entry, &kernel, sizeof(entry));
+    return entry;
+}
+
+void CpuBackend::CopyToHost() {
+    const uint32_t n = config.splitThreads;
+    for (uint32_t i = 0; i < graph.StageCount(); ++i) {
+        switch (graph.Stage(i).kind) {
+            case StageKind::CopyScan:
+                scanCopy.resize(config.tileCount * n);
+                for (uint32_t tile = 0; tile < config.tileCount; ++tile) {
+                    for (uint32_t tid = 0; tid < n; ++tid) {
+                        scanCopy[tile * n + tid] = Scan(tile, tid).load(std::memory_order_relaxed);
+                    }
+                }
+                break;
+            case StageKind::CopyErrors:
+                errorsCopy.assign(errors.begin(), errors.end());
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+const uint32_t* CpuBackend::HostBuffer(GraphBuffer buffer) const {
+    switch (buffer) {
+        case GraphBuffer::Scan:
+            return reinterpret_cast<const uint32_t*>(scan.get());
+        case GraphBuffer::ScanCopy:
+            return scanCopy.data();
+        case GraphBuffer::Errors:
+            return errors.data();
+        case GraphBuffer::ErrorsCopy:
+            return errorsCopy.data();
+        default:
+            return nullptr;
+    }
+}
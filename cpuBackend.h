@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "perfCounters.h"
+#include "placement.h"
+#include "tileAllocator.h"
+#include "trialGraph.h"
+#include "waitPolicy.h"
+
+const uint32_t CACHE_LINE_WORDS = 64 / sizeof(uint32_t);
+
+// How the CPU backend lays out the scan buffer in memory. The validators always see the packed
+// layout: CopyToHost gathers the other layouts back into it, like the blit on the Metal path.
+enum class ScanLayout {
+    Packed,  // scan[tile][lane], as in the shader. 8 tiles share a 64-byte line.
+    Padded,  // One tile per cache line, so successors spinning on a tile never share its line.
+    SoA,     // scan[lane][tile]; the low and high halves live in separate arrays.
+    Count,
+};
+
+const char* ScanLayoutName(ScanLayout layout);
+bool ParseScanLayout(const char* name, ScanLayout* out);
+
+// How the emulated workgroups are scheduled. The OS scheduler is fair, so the unfair policies
+// inject the kind of descheduling that starves a chained scan on hardware without forward progress
+// guarantees.
+enum class SchedulerPolicy {
+    Fair,     // Workers run undisturbed.
+    Yield,    // Every worker yields its core after each tile it posts.
+    Preempt,  // After posting, a worker is descheduled for PREEMPT_US with probability 1/256.
+    Count,
+};
+
+const char* SchedulerPolicyName(SchedulerPolicy policy);
+bool ParseSchedulerPolicy(const char* name, SchedulerPolicy* out);
+
+// Everything that selects a variant of the emulated stress kernel.
+struct CpuConfig {
+    uint32_t workerCount = 1;
+    ScanLayout layout = ScanLayout::Packed;
+    WaitPolicy waitPolicy = WaitPolicy::Spin;
+    MemoryOrder memoryOrder = MemoryOrder::Relaxed;
+    // Tiles per dispatch. The buffers are always sized for TEST_SIZE, the largest.
+    uint32_t tileCount = TEST_SIZE;
+    // Splits the tileCount tiles into independent chains of this many tiles (the last one may be
+    // shorter), all run by one dispatch with one scan_bump. tileCount or more is a single scan.
+    uint32_t tilesPerScan = TEST_SIZE;
+    ScanAlgorithm algorithm = ScanAlgorithm::Chained;
+    SchedulerPolicy scheduler = SchedulerPolicy::Fair;
+    // Split lanes per tile: 2, 4 or 8, for 32-, 64- or 128-bit aggregates. See TileWord().
+    uint32_t splitThreads = SPLIT_THREADS;
+    // Run the in-kernel validation checks (messagePassingCheck and the shuffle checks). false is
+    // production mode: the checks are compiled out and only the final scan is validated.
+    bool checks = true;
+    // Run the stress kernel instantiated for exactly this layout, memory order, split width, wait
+    // policy and checks setting, with every option folded at compile time. false runs the generic
+    // instantiation that reads them from this struct at run time.
+    bool specialized = true;
+    // How workers obtain tile IDs; see TileAllocation.
+    TileAllocation allocation = TileAllocation::Bump;
+    // Which CPUs the workers are pinned to; see Placement. placementSlot is the backend's index
+    // among those running at once, so that they are placed side by side.
+    Placement placement = Placement::None;
+    uint32_t placementSlot = 0;
+    // Let the validators read the scan and error buffers in place wherever they are already in
+    // the layout the validators expect. false always copies them out first, as the Metal path must
+    // for private storage.
+    bool zeroCopy = true;
+};
+
+// Name of the stress kernel instantiation a configuration runs, e.g. "packed/relaxed/x2/spin/
+// checked", or "dynamic" for the generic one.
+std::string VariantName(const CpuConfig& config);
+
+// Names of every specialized instantiation compiled into this build, in registry order.
+std::vector<std::string> CompiledVariantNames();
+
+// Word index of lane tid of tile tileId in the scan buffer.
+inline uint32_t ScanLayoutIndex(ScanLayout layout, uint32_t splitThreads, uint32_t tileId,
+                                uint32_t tid) {
+    switch (layout) {
+        case ScanLayout::Padded:
+            return tileId * CACHE_LINE_WORDS + tid;
+        case ScanLayout::SoA:
+            return tid * TEST_SIZE + tileId;
+        default:
+            return tileId * splitThreads + tid;
+    }
+}
+
+// Host emulation of the init and stress kernels. Each worker thread plays the role of one resident
+// workgroup: it bumps scan_bump for a tile_id, runs that tile's lookback to completion with the
+// SPLIT_THREADS lanes executed in lockstep, then bumps again. Because tiles are handed out in
+// order and the OS scheduler is fair, the backend has the forward progress guarantee the chained
+// scan assumes, which makes it a reference to compare devices against.
+class CpuBackend {
+   public:
+    explicit CpuBackend(const CpuConfig& config);
+
+    // Runs the compute stages of the trial graph, init followed by the scan passes, and blocks
+    // until every worker has finished. When stallIntervalMs is non-zero, the calling thread polls
+    // the progress counters during the stress pass and dumps the blocking tile if the INCLUSIVE
+    // count stops advancing for that long. When counters is non-null it counts the scan passes
+    // alone, not init; it must have been opened on the calling thread, which spawns the workers.
+    void DispatchKernels(uint32_t stallIntervalMs, PerfCounters* counters = nullptr);
+
+    // Runs the copy stages, mirroring the blit on the Metal path. The scan copy is always in the
+    // packed layout. Under zeroCopy the graph has no copy for the error buffer, or for a packed
+    // scan buffer, and the validators read them in place.
+    void CopyToHost();
+
+    // Host-visible contents of a buffer a host stage of Graph() reads, or nullptr.
+    const uint32_t* HostBuffer(GraphBuffer buffer) const;
+
+    // Dispatch, copy back and validate: one whole trial. Failures are recorded in failures when
+    // it is non-null.
+    TrialVerdict RunTrial(uint32_t stallIntervalMs, FailureList* failures = nullptr);
+
+    // Seeds the scheduler randomness of the next trial, so a failing trial can be replayed.
+    void SeedTrial(uint64_t seed);
+    // Tiles of the last trial per SpinBucket of the polls their lookback made, summed over
+    // workers. out has SPIN_BUCKETS entries.
+    void SpinHistogram(uint32_t* out) const;
+
+    const CpuConfig& Config() const { return config; }
+    const TrialGraph& Graph() const { return graph; }
+
+    // Entry point of the stress kernel that config selects, for tools that inspect its machine
+    // code.
+    static const void* KernelEntry(const CpuConfig& config);
+
+   private:
+    // What each worker is doing right now. Written with relaxed stores so the stall report can
+    // name the worker stuck on the blocking tile; padded so workers never share a line.
+    struct alignas(64) WorkerState {
+        std::atomic<uint32_t> tileId{TEST_SIZE};
+        std::atomic<uint32_t> lookbackId{TEST_SIZE};
+        uint32_t rng = 0;  // Only touched by the owning worker, for SchedulerPolicy::Preempt.
+        TileAllocator::Cursor cursor;  // Tile IDs granted to this worker, for batched allocation.
+        uint32_t spins[SPIN_BUCKETS] = {};  // Only touched by the owning worker; see SpinHistogram.
+    };
+
+    // Frees the scan buffer, which starts on a cache line so that a Padded tile fills exactly one
+    // line rather than straddling two.
+    struct LineAlignedDelete {
+        void operator()(std::atomic<uint32_t>* p) const {
+            static_assert(std::is_trivially_destructible<std::atomic<uint32_t>>::value,
+                          "the array new for the scan buffer must not prepend a cookie");
+            ::operator delete[](p, std::align_val_t(64));
+        }
+    };
+
+    std::atomic<uint32_t>& Scan(uint32_t tileId, uint32_t tid) {
+        return scan[ScanLayoutIndex(config.layout, config.splitThreads, tileId, tid)];
+    }
+
+    // One instantiation of the stress kernel, and the registry of all of them. V supplies the
+    // kernel options; see StaticVariant and DynamicVariant in cpuBackend.cpp.
+    using TileKernel = void (CpuBackend::*)(uint32_t tileId, WorkerState& state);
+    template <class V>
+    void StressTile(uint32_t tileId, WorkerState& state);
+    template <size_t... I>
+    static const TileKernel* KernelTable(std::index_sequence<I...>);
+    static TileKernel SelectKernel(const CpuConfig& config);
+
+    void Init();
+    // Runs worker(state) on every worker and returns when all are done, monitoring for stalls if
+    // stallIntervalMs is non-zero. One dispatch, in Metal terms.
+    void Launch(const std::function<void(WorkerState&)>& worker, uint32_t stallIntervalMs);
+    // Hands out the tiles of one dispatch through scan_bump and calls body on each.
+    void ForEachTile(WorkerState& state, const std::function<void(uint32_t)>& body);
+    void MaybeDeschedule(WorkerState& state);
+    void RunComputeStage(StageKind kind, uint32_t stallIntervalMs);
+    // The three reduce-then-scan passes.
+    void Reduce();
+    void ScanReductions();
+    void Downsweep();
+    void ReportStall();
+
+    CpuConfig config;
+    TrialGraph graph;
+    TileKernel stressTile;
+    uint32_t scanWords;
+    std::unique_ptr<std::atomic<uint32_t>[], LineAlignedDelete> scan;
+    std::vector<uint32_t> errors;
+    std::atomic<uint32_t> progress[PROGRESS_SIZE];
+    // Whether the stress tiles publish progress: only while the stall monitor polls it, so that an
+    // unmonitored trial runs without the shared counters.
+    bool monitored = false;
+    ParkingLot lot;
+    TileAllocator allocator;  // Owns scan_bump.
+    std::unique_ptr<WorkerState[]> workers;
+    std::vector<CpuLocation> workerCpus;  // Worker w's CPU; empty when unpinned.
+    std::vector<uint32_t> scanCopy;
+    std::vector<uint32_t> errorsCopy;
+};
@@ -0,0 +1,764 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#ifdef __linux__
+#include <elf.h>
+#include <link.h>
+#endif
+
+#include "chainedScan.h"
+#include "compact.h"
+#include "cpuBackend.h"
+#include "noiseWorkload.h"
+#include "perfCounters.h"
+#include "radixSort.h"
+#include "segmentedScan.h"
+
+// Benchmarks for the CPU backend. Each benchmark runs a fixed number of validated trials per
+// variant and prints one row per variant.
+
+struct BenchArgs {
+    uint32_t trials;
+    uint32_t workers;
+};
+
+// Timing and counters for the stress phase of a set of trials on one backend configuration.
+struct TrialStats {
+    double meanMs = 0;
+    double minMs = 0;
+    double cpuMs = 0;  // Process CPU time (user + system) per trial, across every worker.
+    double validateMs = 0;  // Copies back to the host plus the validators, per trial.
+    double checkUs = 0;     // The validators alone, per trial.
+    uint64_t counters[static_cast<int>(PerfEvent::Count)] = {};  // Per-trial averages.
+    bool countersAvailable = false;
+    bool eventAvailable[static_cast<int>(PerfEvent::Count)] = {};  // Not every CPU has them all.
+    uint32_t scanFailures = 0;   // Trials that failed ValidateScan.
+    uint32_t errorFailures = 0;  // Trials where the in-kernel checks posted an error.
+};
+
+static double ProcessCpuMs() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+}
+
+#ifdef __linux__
+static int FindLoadBias(dl_phdr_info* info, size_t, void* out) {
+    // The executable is the first object visited.
+    *static_cast<uintptr_t*>(out) = info->dlpi_addr;
+    return 1;
+}
+#endif
+
+// Bytes of machine code of the function at entry, from this executable's symbol table; 0 where it
+// cannot be read (non-Linux hosts, stripped binaries).
+static size_t CodeBytes(const void* entry) {
+#ifdef __linux__
+    uintptr_t bias = 0;
+    dl_iterate_phdr(FindLoadBias, &bias);
+    const uintptr_t target = reinterpret_cast<uintptr_t>(entry) - bias;
+    FILE* file = fopen("/proc/self/exe", "rb");
+    if (!file) {
+        return 0;
+    }
+    std::vector<char> image;
+    char buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        image.insert(image.end(), buffer, buffer + got);
+    }
+    fclose(file);
+    if (image.size() < sizeof(ElfW(Ehdr))) {
+        return 0;
+    }
+    const auto* header = reinterpret_cast<const ElfW(Ehdr)*>(image.data());
+    if (memcmp(header->e_ident, ELFMAG, SELFMAG) ||
+        header->e_shoff + (size_t)header->e_shnum * sizeof(ElfW(Shdr)) > image.size()) {
+        return 0;
+    }
+    const auto* sections = reinterpret_cast<const ElfW(Shdr)*>(image.data() + header->e_shoff);
+    for (uint32_t s = 0; s < header->e_shnum; ++s) {
+        if (sections[s].sh_type != SHT_SYMTAB ||
+            sections[s].sh_offset + sections[s].sh_size > image.size()) {
+            continue;
+        }
+        const auto* symbols =
+            reinterpret_cast<const ElfW(Sym)*>(image.data() + sections[s].sh_offset);
+        for (size_t i = 0; i < sections[s].sh_size / sizeof(ElfW(Sym)); ++i) {
+            if (ELF64_ST_TYPE(symbols[i].st_info) == STT_FUNC && symbols[i].st_value == target) {
+                return symbols[i].st_size;
+            }
+        }
+    }
+#else
+    (void)entry;
+#endif
+    return 0;
+}
+
+static TrialStats MeasureTrials(const CpuConfig& config, uint32_t trials) {
+    CpuBackend backend(config);
+    PerfCounters perf;
+    TrialStats stats;
+    stats.countersAvailable = perf.Available();
+    for (int e = 0; e < static_cast<int>(PerfEvent::Count); ++e) {
+        stats.eventAvailable[e] = perf.Available(static_cast<PerfEvent>(e));
+    }
+    stats.minMs = 1e30;
+
+    backend.DispatchKernels(0);  // Warm up: fault in the buffers and the code.
+    for (uint32_t i = 0; i < trials; ++i) {
+        perf.Start();
+        const double cpuStart = ProcessCpuMs();
+        const auto start = std::chrono::steady_clock::now();
+        backend.DispatchKernels(0);
+        const std::chrono::duration<double, std::milli> ms =
+            std::chrono::steady_clock::now() - start;
+        stats.cpuMs += ProcessCpuMs() - cpuStart;
+        perf.Stop();
+
+        stats.meanMs += ms.count();
+        stats.minMs = std::min(stats.minMs, ms.count());
+        for (int e = 0; e < static_cast<int>(PerfEvent::Count); ++e) {
+            stats.counters[e] += perf.Get(static_cast<PerfEvent>(e));
+        }
+        const auto validateStart = std::chrono::steady_clock::now();
+        backend.CopyToHost();
+        const auto checkStart = std::chrono::steady_clock::now();
+        const TrialVerdict verdict = RunHostStages(
+            backend.Graph(), [&](GraphBuffer buffer) { return backend.HostBuffer(buffer); },
+            config.tilesPerScan, config.splitThreads);
+        const auto validateEnd = std::chrono::steady_clock::now();
+        const std::chrono::duration<double, std::milli> validateMs = validateEnd - validateStart;
+        const std::chrono::duration<double, std::micro> checkUs = validateEnd - checkStart;
+        stats.validateMs += validateMs.count();
+        stats.checkUs += checkUs.count();
+        stats.scanFailures += !verdict.validScan;
+        stats.errorFailures += !verdict.validErrors;
+    }
+    if (trials) {
+        stats.meanMs /= trials;
+        stats.cpuMs /= trials;
+        stats.validateMs /= trials;
+        stats.checkUs /= trials;
+        for (uint64_t& c : stats.counters) {
+            c /= trials;
+        }
+    }
+    return stats;
+}
+
+static void PrintStatsHeader(const char* variantColumn) {
+    printf("%-12s %10s %10s %10s", variantColumn, "mean ms", "min ms", "cpu ms");
+    for (int e = 0; e < static_cast<int>(PerfEvent::Count); ++e) {
+        printf(" %14s", PerfEventName(static_cast<PerfEvent>(e)));
+    }
+    printf(" %9s %9s\n", "scan err", "chk err");
+}
+
+static void PrintStatsRow(const char* variant, const TrialStats& stats) {
+    printf("%-12s %10.3f %10.3f %10.3f", variant, stats.meanMs, stats.minMs, stats.cpuMs);
+    for (int e = 0; e < static_cast<int>(PerfEvent::Count); ++e) {
+        if (stats.eventAvailable[e]) {
+            printf(" %14llu", (unsigned long long)stats.counters[e]);
+        } else {
+            printf(" %14s", "n/a");
+        }
+    }
+    printf(" %9u %9u\n", stats.scanFailures, stats.errorFailures);
+}
+
+// Packed vs. one-tile-per-line vs. structure-of-arrays scan buffer.
+static void BenchLayout(const BenchArgs& args) {
+    PrintStatsHeader("layout");
+    for (int l = 0; l < static_cast<int>(ScanLayout::Count); ++l) {
+        CpuConfig config;
+        config.workerCount = args.workers;
+        config.layout = static_cast<ScanLayout>(l);
+        PrintStatsRow(ScanLayoutName(config.layout), MeasureTrials(config, args.trials));
+    }
+}
+
+// Every wait policy, once with half as many workers as cores and once with four times as many.
+static void BenchWait(const BenchArgs& args) {
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const uint32_t workerCounts[] = {std::max(1u, cores / 2), cores * 4};
+    for (uint32_t workers : workerCounts) {
+        printf("\n%u workers on %u cores (%s)\n", workers, cores,
+               workers > cores ? "oversubscribed" : "undersubscribed");
+        PrintStatsHeader("policy");
+        for (int p = 0; p < static_cast<int>(WaitPolicy::Count); ++p) {
+            CpuConfig config;
+            config.workerCount = workers;
+            config.waitPolicy = static_cast<WaitPolicy>(p);
+            PrintStatsRow(WaitPolicyName(config.waitPolicy), MeasureTrials(config, args.trials));
+        }
+    }
+}
+
+// Correctness and cost of each memory order, across worker counts. The error columns are the
+// built-in checks; ns/tile is the trial latency spread over the chain, i.e. the lookback cost.
+static void BenchMemoryOrder(const BenchArgs& args) {
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> workerCounts = {1, args.workers, cores * 2};
+    std::sort(workerCounts.begin(), workerCounts.end());
+    workerCounts.erase(std::unique(workerCounts.begin(), workerCounts.end()), workerCounts.end());
+    printf("%-8s %-8s %10s %10s %9s %9s %9s\n", "order", "workers", "mean ms", "ns/tile",
+           "trials", "scan err", "chk err");
+    for (int o = 0; o < static_cast<int>(MemoryOrder::Count); ++o) {
+        for (uint32_t workers : workerCounts) {
+            CpuConfig config;
+            config.workerCount = workers;
+            config.memoryOrder = static_cast<MemoryOrder>(o);
+            const TrialStats stats = MeasureTrials(config, args.trials);
+            printf("%-8s %-8u %10.3f %10.2f %9u %9u %9u\n", MemoryOrderName(config.memoryOrder),
+                   workers, stats.meanMs, stats.meanMs * 1e6 / TEST_SIZE, args.trials,
+                   stats.scanFailures, stats.errorFailures);
+        }
+    }
+}
+
+// Many independent scans in one dispatch: fixed TEST_SIZE tiles in total, split into more and
+// more chains that share a single scan_bump.
+static void BenchBatch(const BenchArgs& args) {
+    printf("%-8s %12s %10s %12s %9s %9s\n", "scans", "tiles/scan", "mean ms", "scans/ms",
+           "scan err", "chk err");
+    for (uint32_t scans = 1; scans <= TEST_SIZE; scans *= 4) {
+        CpuConfig config;
+        config.workerCount = args.workers;
+        config.tilesPerScan = (TEST_SIZE + scans - 1) / scans;
+        const TrialStats stats = MeasureTrials(config, args.trials);
+        printf("%-8u %12u %10.3f %12.2f %9u %9u\n", scans, config.tilesPerScan, stats.meanMs,
+               scans / stats.meanMs, stats.scanFailures, stats.errorFailures);
+    }
+}
+
+// Chained scan against the reduce-then-scan baseline, per scheduler policy and chain length.
+// Reduce-then-scan moves three times the scan buffer but never waits on another worker, so the
+// gap between the two shows what the chained scan loses when its predecessors are descheduled.
+static void BenchReduceThenScan(const BenchArgs& args) {
+    printf("%-8s %12s %-8s %10s %10s %9s %9s\n", "sched", "tiles/scan", "algo", "mean ms",
+           "min ms", "scan err", "chk err");
+    for (int s = 0; s < static_cast<int>(SchedulerPolicy::Count); ++s) {
+        for (uint32_t tilesPerScan = TEST_SIZE; tilesPerScan >= 16; tilesPerScan /= 16) {
+            for (int a = 0; a < static_cast<int>(ScanAlgorithm::Count); ++a) {
+                CpuConfig config;
+                config.workerCount = args.workers;
+                config.waitPolicy = WaitPolicy::Pause;
+                config.tilesPerScan = tilesPerScan;
+                config.scheduler = static_cast<SchedulerPolicy>(s);
+                config.algorithm = static_cast<ScanAlgorithm>(a);
+                const TrialStats stats = MeasureTrials(config, args.trials);
+                printf("%-8s %12u %-8s %10.3f %10.3f %9u %9u\n",
+                       SchedulerPolicyName(config.scheduler), tilesPerScan,
+                       ScanAlgorithmName(config.algorithm), stats.meanMs, stats.minMs,
+                       stats.scanFailures, stats.errorFailures);
+            }
+        }
+    }
+}
+
+// Lookback cost per split lane count. Every extra pair of lanes adds a 32-bit word to the
+// aggregate, so each lookback step loads, ballots and gathers more lanes; ns/step is the mean trial
+// latency per tile. Run once with a single worker, where the chain is walked strictly in order, and
+// once with the requested worker count.
+static void BenchSplit(const BenchArgs& args) {
+    std::vector<uint32_t> workerCounts = {1, args.workers};
+    workerCounts.erase(std::unique(workerCounts.begin(), workerCounts.end()), workerCounts.end());
+    printf("%-8s %-8s %10s %10s %10s %14s %9s %9s\n", "lanes", "workers", "mean ms", "ns/tile",
+           "cpu ms", "instr/tile", "scan err", "chk err");
+    for (uint32_t workers : workerCounts) {
+        for (uint32_t lanes = 2; lanes <= MAX_SPLIT_THREADS; lanes *= 2) {
+            CpuConfig config;
+            config.workerCount = workers;
+            config.splitThreads = lanes;
+            const TrialStats stats = MeasureTrials(config, args.trials);
+            const uint64_t instructions =
+                stats.counters[static_cast<int>(PerfEvent::Instructions)] / TEST_SIZE;
+            char instrColumn[32] = "n/a";
+            if (stats.countersAvailable) {
+                snprintf(instrColumn, sizeof(instrColumn), "%llu",
+                         (unsigned long long)instructions);
+            }
+            printf("%-8u %-8u %10.3f %10.2f %10.3f %14s %9u %9u\n", lanes, workers, stats.meanMs,
+                   stats.meanMs * 1e6 / TEST_SIZE, stats.cpuMs, instrColumn, stats.scanFailures,
+                   stats.errorFailures);
+        }
+    }
+}
+
+// Specialized against generic kernels. Each row runs one configuration twice: with the stress
+// kernel instantiated for it and with the dynamic instantiation that reads every option at run
+// time. A single worker finds every predecessor already INCLUSIVE, so each tile runs exactly one
+// lookback step and instructions per tile are deterministic; the difference between the two is
+// what the runtime branches on the options cost.
+static void BenchVariants(const BenchArgs& args) {
+    struct Row {
+        const char* feature;
+        void (*apply)(CpuConfig&);
+    };
+    const Row rows[] = {
+        {"baseline", [](CpuConfig&) {}},
+        {"padded", [](CpuConfig& c) { c.layout = ScanLayout::Padded; }},
+        {"soa", [](CpuConfig& c) { c.layout = ScanLayout::SoA; }},
+        {"seqcst", [](CpuConfig& c) { c.memoryOrder = MemoryOrder::SeqCst; }},
+        {"x4", [](CpuConfig& c) { c.splitThreads = 4; }},
+        {"x8", [](CpuConfig& c) { c.splitThreads = 8; }},
+        {"park", [](CpuConfig& c) { c.waitPolicy = WaitPolicy::Park; }},
+        {"unchecked", [](CpuConfig& c) { c.checks = false; }},
+    };
+    printf("%-10s %-34s %10s %10s %14s %14s\n", "feature", "variant", "mean ms", "ns/tile",
+           "instr/tile", "vs dynamic");
+    for (const Row& row : rows) {
+        uint64_t dynamicInstructions = 0;
+        for (int specialized = 0; specialized < 2; ++specialized) {
+            CpuConfig config;
+            config.workerCount = 1;
+            row.apply(config);
+            config.specialized = specialized != 0;
+            const TrialStats stats = MeasureTrials(config, args.trials);
+            const uint64_t instructions =
+                stats.counters[static_cast<int>(PerfEvent::Instructions)] / TEST_SIZE;
+            char instrColumn[32] = "n/a";
+            char deltaColumn[32] = "n/a";
+            if (stats.countersAvailable) {
+                snprintf(instrColumn, sizeof(instrColumn), "%llu",
+                         (unsigned long long)instructions);
+                if (specialized) {
+                    snprintf(deltaColumn, sizeof(deltaColumn), "%lld",
+                             (long long)instructions - (long long)dynamicInstructions);
+                } else {
+                    dynamicInstructions = instructions;
+                    snprintf(deltaColumn, sizeof(deltaColumn), "-");
+                }
+            }
+            printf("%-10s %-34s %10.3f %10.2f %14s %14s\n", row.feature,
+                   VariantName(config).c_str(), stats.meanMs, stats.meanMs * 1e6 / TEST_SIZE,
+                   instrColumn, deltaColumn);
+            if (stats.scanFailures || stats.errorFailures) {
+                printf("  %u scan and %u check failures\n", stats.scanFailures,
+                       stats.errorFailures);
+            }
+        }
+    }
+
+    // The same specialized variant with the checks compiled in and out. Whatever the unchecked
+    // kernel saves in instructions per tile, and in bytes of machine code where the counters are
+    // unavailable, is what the disabled checks would otherwise cost.
+    printf("\nchecks compiled in vs out, same specialized variant\n");
+    printf("%-26s %14s %14s %14s %14s\n", "variant", "checked instr", "unchecked", "checked B",
+           "unchecked B");
+    for (uint32_t lanes = 2; lanes <= MAX_SPLIT_THREADS; lanes *= 2) {
+        char instr[2][32] = {"n/a", "n/a"};
+        char bytes[2][32] = {"n/a", "n/a"};
+        CpuConfig config;
+        config.workerCount = 1;
+        config.splitThreads = lanes;
+        for (int checks = 1; checks >= 0; --checks) {
+            config.checks = checks != 0;
+            const TrialStats stats = MeasureTrials(config, args.trials);
+            const uint64_t perTile =
+                stats.counters[static_cast<int>(PerfEvent::Instructions)] / TEST_SIZE;
+            if (stats.countersAvailable) {
+                snprintf(instr[1 - checks], sizeof(instr[0]), "%llu", (unsigned long long)perTile);
+            }
+            if (const size_t code = CodeBytes(CpuBackend::KernelEntry(config))) {
+                snprintf(bytes[1 - checks], sizeof(bytes[0]), "%zu", code);
+            }
+        }
+        config.checks = true;
+        std::string name = VariantName(config);
+        name = name.substr(0, name.rfind('/'));
+        printf("%-26s %14s %14s %14s %14s\n", name.c_str(), instr[0], instr[1], bytes[0],
+               bytes[1]);
+    }
+}
+
+// Checked against production mode, per split width and worker count: the cost of running the
+// validation checks after every load and gather. Both are specialized kernels, so the difference is
+// exactly the checks. Production trials are validated by the final scan check only.
+static void BenchProduction(const BenchArgs& args) {
+    std::vector<uint32_t> workerCounts = {1, args.workers};
+    workerCounts.erase(std::unique(workerCounts.begin(), workerCounts.end()), workerCounts.end());
+    printf("%-6s %-8s %12s %12s %10s %16s %9s\n", "lanes", "workers", "checked ms",
+           "unchecked ms", "overhead", "instr/tile delta", "scan err");
+    for (uint32_t workers : workerCounts) {
+        for (uint32_t lanes = 2; lanes <= MAX_SPLIT_THREADS; lanes *= 2) {
+            TrialStats stats[2];
+            for (int checks = 0; checks < 2; ++checks) {
+                CpuConfig config;
+                config.workerCount = workers;
+                config.splitThreads = lanes;
+                config.checks = checks != 0;
+                stats[checks] = MeasureTrials(config, args.trials);
+            }
+            const int instructions = static_cast<int>(PerfEvent::Instructions);
+            char deltaColumn[32] = "n/a";
+            if (stats[0].countersAvailable) {
+                snprintf(deltaColumn, sizeof(deltaColumn), "%lld",
+                         ((long long)stats[1].counters[instructions] -
+                          (long long)stats[0].counters[instructions]) /
+                             TEST_SIZE);
+            }
+            printf("%-6u %-8u %12.3f %12.3f %9.1f%% %16s %9u\n", lanes, workers, stats[1].meanMs,
+                   stats[0].meanMs, (stats[1].meanMs / stats[0].meanMs - 1) * 100, deltaColumn,
+                   stats[0].scanFailures + stats[1].scanFailures);
+        }
+    }
+}
+
+// Host-side validation per trial with the buffers copied out first, as the Metal path does for
+// private storage, and read in place. Only the packed layout can be read in place; the others are
+// always gathered, so they show the copy cost on both rows.
+static void BenchValidation(const BenchArgs& args) {
+    printf("%-8s %-6s %-10s %12s %10s %12s %9s\n", "layout", "lanes", "validation", "validate ms",
+           "checks us", "copied KiB", "err");
+    for (int l = 0; l < static_cast<int>(ScanLayout::Count); ++l) {
+        for (uint32_t lanes = 2; lanes <= MAX_SPLIT_THREADS; lanes *= 2) {
+            for (int zeroCopy = 0; zeroCopy < 2; ++zeroCopy) {
+                CpuConfig config;
+                config.workerCount = args.workers;
+                config.layout = static_cast<ScanLayout>(l);
+                config.splitThreads = lanes;
+                config.zeroCopy = zeroCopy != 0;
+                const TrialStats stats = MeasureTrials(config, args.trials);
+
+                uint32_t copiedWords = 0;
+                const TrialGraph graph = CpuBackend(config).Graph();
+                for (uint32_t i = 0; i < graph.StageCount(); ++i) {
+                    const StageKind kind = graph.Stage(i).kind;
+                    copiedWords += kind == StageKind::CopyScan     ? TEST_SIZE * lanes
+                                   : kind == StageKind::CopyErrors ? TEST_SIZE * lanes * 2
+                                                                   : 0;
+                }
+                printf("%-8s %-6u %-10s %12.3f %10.1f %12.1f %9u\n",
+                       ScanLayoutName(config.layout), lanes, zeroCopy ? "in place" : "copy",
+                       stats.validateMs, stats.checkUs, copiedWords * sizeof(uint32_t) / 1024.0,
+                       stats.scanFailures + stats.errorFailures);
+            }
+        }
+    }
+}
+
+// Tile-ID allocation per policy as the worker count grows. First the allocator alone: workers drain
+// ALLOC_IDS IDs with no scan work in between, which is the worst case for contention on scan_bump.
+// Then whole trials, where allocation overlaps the lookback. Batched grants give a worker's next
+// grant a dependency on every other worker's current one, so oversubscribed they cost a scheduler
+// time slice per grant; the trials use Backoff, which yields, and stay at or below the core count
+// unless asked for more.
+static void BenchAllocation(const BenchArgs& args) {
+    const uint32_t ALLOC_IDS = 1u << 24;
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> workerCounts = {1, std::max(1u, cores / 2), cores, args.workers};
+    std::sort(workerCounts.begin(), workerCounts.end());
+    workerCounts.erase(std::unique(workerCounts.begin(), workerCounts.end()), workerCounts.end());
+
+    printf("%-8s %-8s %12s %10s %10s %9s\n", "alloc", "workers", "Mids/s", "trial ms", "ns/tile",
+           "scan err");
+    for (int a = 0; a < static_cast<int>(TileAllocation::Count); ++a) {
+        const TileAllocation allocation = static_cast<TileAllocation>(a);
+        for (uint32_t workers : workerCounts) {
+            TileAllocator allocator(allocation, workers);
+            const auto start = std::chrono::steady_clock::now();
+            RunWorkers(workers, [&](uint32_t w) {
+                TileAllocator::Cursor cursor;
+                while (allocator.Next(w, cursor, ALLOC_IDS) < ALLOC_IDS) {
+                }
+            });
+            const std::chrono::duration<double, std::micro> us =
+                std::chrono::steady_clock::now() - start;
+
+            CpuConfig config;
+            config.workerCount = workers;
+            config.waitPolicy = WaitPolicy::Backoff;
+            config.allocation = allocation;
+            const TrialStats stats = MeasureTrials(config, args.trials);
+            printf("%-8s %-8u %12.1f %10.3f %10.2f %9u\n", TileAllocationName(allocation),
+                   workers, ALLOC_IDS / us.count(), stats.meanMs, stats.meanMs * 1e6 / TEST_SIZE,
+                   stats.scanFailures + stats.errorFailures);
+        }
+    }
+}
+
+// Checks a sort result against std::stable_sort of the original input. For key-value sorts the
+// values are the original indices, which also verifies stability.
+static bool CheckSorted(const std::vector<uint32_t>& input, const std::vector<uint32_t>& keys,
+                        const std::vector<uint32_t>* values) {
+    if (!values) {
+        std::vector<uint32_t> expected = input;
+        std::sort(expected.begin(), expected.end());
+        return expected == keys;
+    }
+    std::vector<uint32_t> order(input.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) { return input[a] < input[b]; });
+    for (size_t i = 0; i < input.size(); ++i) {
+        if (keys[i] != input[order[i]] || (*values)[i] != order[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Keys per second of the chained radix sort from 1M to 256M random keys, keys only and pairs.
+// Each size repeats at most `trials` times and at most enough to sort 2^30 keys in total.
+static void BenchSort(const BenchArgs& args) {
+    CpuRadixSort sorter(args.workers);
+    std::mt19937 rng(1234);
+    printf("%-8s %12s %10s %12s %8s\n", "mode", "keys", "mean ms", "Mkeys/s", "valid");
+    for (size_t n = size_t(1) << 20; n <= size_t(1) << 28; n <<= 2) {
+        std::vector<uint32_t> input(n);
+        for (uint32_t& k : input) {
+            k = rng();
+        }
+        const uint32_t reps = (uint32_t)std::max<size_t>(
+            1, std::min<size_t>(args.trials, (size_t(1) << 30) / n));
+        for (int withValues = 0; withValues < 2; ++withValues) {
+            std::vector<uint32_t> keys;
+            std::vector<uint32_t> values;
+            double totalMs = 0;
+            for (uint32_t r = 0; r < reps; ++r) {
+                keys = input;
+                if (withValues) {
+                    values.resize(n);
+                    std::iota(values.begin(), values.end(), 0u);
+                }
+                const auto start = std::chrono::steady_clock::now();
+                sorter.Sort(keys.data(), withValues ? values.data() : nullptr, n);
+                const std::chrono::duration<double, std::milli> ms =
+                    std::chrono::steady_clock::now() - start;
+                totalMs += ms.count();
+            }
+            const double meanMs = totalMs / reps;
+            const bool valid = CheckSorted(input, keys, withValues ? &values : nullptr);
+            printf("%-8s %12zu %10.3f %12.1f %8s\n", withValues ? "pairs" : "keys", n, meanMs,
+                   n / meanMs / 1e3, valid ? "ok" : "FAILED");
+        }
+    }
+}
+
+// Single-pass chained compaction against the two-pass count-then-scatter baseline, keeping
+// elements below a threshold chosen for each selectivity. Both are checked against std::copy_if.
+static void BenchCompact(const BenchArgs& args) {
+    const size_t n = size_t(1) << 26;
+    CpuCompact compact(args.workers);
+    std::mt19937 rng(1234);
+    std::vector<uint32_t> input(n);
+    for (uint32_t& x : input) {
+        x = rng();
+    }
+    std::vector<uint32_t> out[2] = {std::vector<uint32_t>(n), std::vector<uint32_t>(n)};
+    std::vector<uint32_t> expected;
+    expected.reserve(n);
+    const uint32_t reps = std::max(1u, std::min(args.trials, 16u));
+    printf("%zu elements, %u repetitions\n", n, reps);
+    printf("%-10s %12s %12s %12s %12s %8s\n", "select %", "chained ms", "two-pass ms",
+           "chained GB/s", "two-pass GB/s", "valid");
+    const uint32_t percents[] = {1, 10, 25, 50, 75, 90, 99};
+    for (uint32_t percent : percents) {
+        const uint32_t threshold = (uint32_t)(0x100000000ull * percent / 100);
+        auto pred = [threshold](uint32_t x) { return x < threshold; };
+        double ms[2] = {};
+        size_t kept[2] = {};
+        for (uint32_t r = 0; r < reps; ++r) {
+            for (int variant = 0; variant < 2; ++variant) {
+                uint32_t* dst = out[variant].data();
+                const auto start = std::chrono::steady_clock::now();
+                kept[variant] = variant ? compact.CompactTwoPass(input.data(), n, dst, pred)
+                                        : compact.Compact(input.data(), n, dst, pred);
+                const std::chrono::duration<double, std::milli> elapsed =
+                    std::chrono::steady_clock::now() - start;
+                ms[variant] += elapsed.count() / reps;
+            }
+        }
+        expected.clear();
+        std::copy_if(input.begin(), input.end(), std::back_inserter(expected), pred);
+        bool valid = true;
+        for (int variant = 0; variant < 2; ++variant) {
+            valid = valid && kept[variant] == expected.size() &&
+                    std::equal(expected.begin(), expected.end(), out[variant].begin());
+        }
+        const double bytes = double(n) * sizeof(uint32_t);
+        printf("%-10u %12.3f %12.3f %12.2f %12.2f %8s\n", percent, ms[0], ms[1],
+               bytes / ms[0] / 1e6, bytes / ms[1] / 1e6, valid ? "ok" : "FAILED");
+    }
+}
+
+// Segmented scan with segments from one tile up to the whole array, against the sequential
+// reference. Shorter segments should cut the mean lookback depth.
+static void BenchSegmented(const BenchArgs& args) {
+    const size_t n = size_t(1) << 24;
+    const size_t tiles = n / CpuSegmentedScan::TILE_ELEMENTS;
+    CpuSegmentedScan scan(args.workers);
+    std::mt19937 rng(1234);
+    std::vector<uint32_t> values(n);
+    for (uint32_t& v : values) {
+        v = rng() & 0xFF;
+    }
+    std::vector<uint8_t> heads(n);
+    std::vector<uint32_t> out(n);
+    std::vector<uint32_t> expected(n);
+    const uint32_t reps = std::max(1u, std::min(args.trials, 16u));
+    printf("%zu elements in %zu tiles, %u repetitions\n", n, tiles, reps);
+    printf("%-14s %10s %12s %8s\n", "segment tiles", "mean ms", "mean depth", "valid");
+    for (size_t segmentTiles = 1; segmentTiles <= tiles; segmentTiles *= 4) {
+        const size_t segment = segmentTiles * CpuSegmentedScan::TILE_ELEMENTS;
+        for (size_t i = 0; i < n; ++i) {
+            // Offset the heads by a little so segments straddle tile boundaries.
+            heads[i] = i % segment == segment / 3;
+        }
+        double ms = 0;
+        for (uint32_t r = 0; r < reps; ++r) {
+            const auto start = std::chrono::steady_clock::now();
+            scan.Scan(values.data(), heads.data(), n, out.data());
+            const std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+            ms += elapsed.count() / reps;
+        }
+        SegmentedScanReference(values.data(), heads.data(), n, expected.data());
+        printf("%-14zu %10.3f %12.2f %8s\n", segmentTiles, ms, scan.MeanLookbackDepth(),
+               out == expected ? "ok" : "FAILED");
+    }
+}
+
+// Trial latency and failures under each kind of co-runner load as its intensity grows. The noise
+// runs for the whole measurement, so its rate shows how hard the trials pushed back.
+static void BenchNoise(const BenchArgs& args) {
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> intensities = {std::max(1u, cores / 2), cores, cores * 2};
+    intensities.erase(std::unique(intensities.begin(), intensities.end()), intensities.end());
+    printf("%-8s %-8s %10s %10s %12s %9s %9s\n", "noise", "threads", "mean ms", "min ms",
+           "noise Mop/s", "scan err", "chk err");
+    CpuConfig config;
+    config.workerCount = args.workers;
+    const TrialStats quiet = MeasureTrials(config, args.trials);
+    printf("%-8s %-8u %10.3f %10.3f %12s %9u %9u\n", NoiseKindName(NoiseKind::None), 0,
+           quiet.meanMs, quiet.minMs, "-", quiet.scanFailures, quiet.errorFailures);
+    for (uint32_t k = 1; k < static_cast<uint32_t>(NoiseKind::Count); ++k) {
+        for (uint32_t threads : intensities) {
+            const NoiseConfig noise = {static_cast<NoiseKind>(k), threads};
+            NoiseGenerator generator(noise);
+            const auto start = std::chrono::steady_clock::now();
+            const uint64_t before = generator.Operations();
+            const TrialStats stats = MeasureTrials(config, args.trials);
+            const std::chrono::duration<double, std::micro> us =
+                std::chrono::steady_clock::now() - start;
+            printf("%-8s %-8u %10.3f %10.3f %12.1f %9u %9u\n", NoiseKindName(noise.kind),
+                   threads, stats.meanMs, stats.minMs,
+                   (generator.Operations() - before) / us.count(), stats.scanFailures,
+                   stats.errorFailures);
+        }
+    }
+}
+
+// Trial latency per worker placement policy. The span columns count the sockets, last-level
+// caches and physical cores the workers were pinned to.
+static void BenchPlacement(const BenchArgs& args) {
+    printf("%-8s %8s %6s %6s %10s %10s %10s %9s %9s\n", "policy", "sockets", "llcs", "cores",
+           "mean ms", "min ms", "ns/tile", "scan err", "chk err");
+    for (int p = 0; p < static_cast<int>(Placement::Count); ++p) {
+        CpuConfig config;
+        config.workerCount = args.workers;
+        config.placement = static_cast<Placement>(p);
+        std::vector<uint32_t> packages;
+        std::vector<uint32_t> llcs;
+        std::vector<uint32_t> cores;
+        for (const CpuLocation& cpu : PlaceWorkers(config.placement, args.workers, 0)) {
+            packages.push_back(cpu.package);
+            llcs.push_back(cpu.llc);
+            cores.push_back(cpu.core);
+        }
+        for (auto* ids : {&packages, &llcs, &cores}) {
+            std::sort(ids->begin(), ids->end());
+            ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+        }
+        const TrialStats stats = MeasureTrials(config, args.trials);
+        if (packages.empty()) {
+            printf("%-8s %8s %6s %6s", PlacementName(config.placement), "-", "-", "-");
+        } else {
+            printf("%-8s %8zu %6zu %6zu", PlacementName(config.placement), packages.size(),
+                   llcs.size(), cores.size());
+        }
+        printf(" %10.3f %10.3f %10.2f %9u %9u\n", stats.meanMs, stats.minMs,
+               stats.meanMs * 1e6 / TEST_SIZE, stats.scanFailures, stats.errorFailures);
+    }
+}
+
+struct Benchmark {
+    const char* name;
+    const char* description;
+    void (*run)(const BenchArgs&);
+};
+
+static const Benchmark BENCHMARKS[] = {
+    {"layout", "trial latency and cache traffic per scan buffer layout", BenchLayout},
+    {"wait", "trial latency and CPU time per wait policy, under- and oversubscribed", BenchWait},
+    {"order", "error rates and lookback latency per memory order", BenchMemoryOrder},
+    {"batch", "throughput of many independent scans in one dispatch", BenchBatch},
+    {"rts", "chained vs reduce-then-scan per scheduler policy and chain length",
+     BenchReduceThenScan},
+    {"split", "lookback cost for 2, 4 and 8 split lanes (32- to 128-bit payloads)", BenchSplit},
+    {"variants", "specialized vs dynamic instructions per tile, and checks compiled in vs out",
+     BenchVariants},
+    {"production", "overhead of the in-kernel checks over production mode", BenchProduction},
+    {"alloc", "tile-ID allocation throughput and trial latency per allocator", BenchAllocation},
+    {"validate", "per-trial validation time with copied and in-place buffers", BenchValidation},
+    {"sort", "keys/s of the chained radix sort, 1M to 256M keys", BenchSort},
+    {"compact", "chained vs two-pass stream compaction, 1% to 99% selectivity", BenchCompact},
+    {"segmented", "segmented scan latency and lookback depth per segment length", BenchSegmented},
+    {"placement", "trial latency per worker placement: compact, scatter, socket, chain",
+     BenchPlacement},
+    {"noise", "trial latency and failures under memory, atomic and compute co-runner load",
+     BenchNoise},
+};
+
+static bool ParseArg(const char* arg, long limit, long* out) {
+    char* endptr;
+    errno = 0;
+    long val = strtol(arg, &endptr, 10);
+    if (errno != 0 || endptr == arg || *endptr != '\0' || val <= 0 || val >= limit) {
+        return false;
+    }
+    *out = val;
+    return true;
+}
+
+int main(int argc, const char* argv[]) {
+    long trials_val = 100;
+    long workers_val = std::thread::hardware_concurrency();
+    const Benchmark* bench = nullptr;
+    if (argc >= 2) {
+        for (const Benchmark& b : BENCHMARKS) {
+            if (!strcmp(argv[1], b.name)) {
+                bench = &b;
+            }
+        }
+    }
+    if (!bench || argc > 4 || (argc > 2 && !ParseArg(argv[2], 1L << 31, &trials_val)) ||
+        (argc > 3 && !ParseArg(argv[3], 4096, &workers_val))) {
+        printf("Usage: %s <benchmark> [trials] [workers]\n", argv[0]);
+        printf("trials defaults to 100 per variant, workers to one per core.\n");
+        printf("Benchmarks:\n");
+        for (const Benchmark& b : BENCHMARKS) {
+            printf("  %-12s %s\n", b.name, b.description);
+        }
+        return 1;
+    }
+
+    BenchArgs args = {(uint32_t)trials_val, workers_val ? (uint32_t)workers_val : 1};
+    printf("%s: %u trials per variant, %u workers\n", bench->name, args.trials, args.workers);
+    bench->run(args);
+    return 0;
+}
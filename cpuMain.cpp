@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "checkpoint.h"
+#include "commandLine.h"
+#include "noiseWorkload.h"
+#include "perfCounters.h"
+#include "placement.h"
+#include "shardRunner.h"
+#include "trialRunner.h"
+
+// Everything the command line selects.
+struct RunOptions {
+    uint32_t trials = 1;
+    uint32_t stallIntervalMs = 0;
+    uint32_t concurrentTrials = 1;
+    uint32_t shards = 1;  // Processes the campaign is split across; see shardRunner.h.
+    CpuConfig config;
+    NoiseConfig noise;
+    uint64_t seed = 0;  // Campaign seed; see TrialSeed.
+    const char* resultsPath = nullptr;
+    const char* failuresPath = FAILURE_LOG_PATH;
+    const char* checkpointPath = CHECKPOINT_PATH;
+    bool resume = false;
+    bool perfCounters = false;  // Hardware events per trial, into the results store.
+    ReportFormat report = ReportFormat::Text;
+    // Every setting as options, echoed into the results store and the checkpoint.
+    std::string settings;
+};
+
+// Runs the campaign in segments of about CHECKPOINT_INTERVAL_S seconds of trials and checkpoints
+// it between segments once it has run that long, and at the end if it ever did. A segment ends
+// only when all of its trials have, so the checkpoint is exact; what that costs is the time the
+// other runners idle while the last trial of each segment finishes.
+static bool RunCampaign(TrialRunner& runner, const RunOptions& options, const TrialSinks& sinks,
+                        CampaignState& state) {
+    bool checkpointed = options.resume;
+    uint32_t segment = options.concurrentTrials;
+    auto lastCheckpoint = std::chrono::steady_clock::now();
+    while (!state.Finished()) {
+        const uint32_t count = std::min(segment, state.batchSize - state.nextTrial + 1);
+        const TrialSummary summary =
+            runner.Run(state.nextTrial, count, options.stallIntervalMs, sinks);
+        state.nextTrial += count;
+        state.attempted += summary.attempted;
+        state.passed += summary.passed;
+        state.firstFailure = summary.firstFailure;
+        state.seconds += summary.seconds;
+        for (uint32_t trial : summary.failedTrials) {
+            state.AddFailing(trial, TrialSeed(options.seed, trial));
+        }
+        if (summary.seconds > 0) {
+            const double perSecond = summary.attempted / summary.seconds;
+            segment = std::max(options.concurrentTrials,
+                               (uint32_t)std::min(perSecond * CHECKPOINT_INTERVAL_S, 1e9));
+        }
+
+        const std::chrono::duration<double> sinceCheckpoint =
+            std::chrono::steady_clock::now() - lastCheckpoint;
+        if (sinceCheckpoint.count() >= CHECKPOINT_INTERVAL_S ||
+            (checkpointed && state.Finished())) {
+            if (!SaveCheckpoint(options.checkpointPath, state)) {
+                return false;
+            }
+            checkpointed = true;
+            lastCheckpoint = std::chrono::steady_clock::now();
+        }
+    }
+    return true;
+}
+
+static void PrintTextReport(const RunOptions& options, const CampaignState& state) {
+    const CpuConfig& config = options.config;
+    if (state.firstFailure) {
+        for (uint32_t i = 0; i < state.failingCount; ++i) {
+            printf("Batch %u failed with seed 0x%016llX.\n", state.failing[i].trial,
+                   (unsigned long long)state.failing[i].seed);
+        }
+        printf("Batch %u: FAILED. Exiting test\n", state.firstFailure);
+        return;
+    }
+
+    printf("%u / %u ALL TESTS PASSED\n", state.passed, state.batchSize);
+    printf("%u trials in %.3f s (%.1f trials/s)\n", state.attempted, state.seconds,
+           state.seconds > 0 ? state.attempted / state.seconds : 0.0);
+    printf("%u concurrent x %u workers, %s layout, %s wait, %s memory order\n",
+           options.concurrentTrials, config.workerCount, ScanLayoutName(config.layout),
+           WaitPolicyName(config.waitPolicy), MemoryOrderName(config.memoryOrder));
+    printf("%s algorithm, %s scheduler, %u split threads, %u tiles\n",
+           ScanAlgorithmName(config.algorithm), SchedulerPolicyName(config.scheduler),
+           config.splitThreads, config.tileCount);
+    printf("kernel: %s%s, %s tile allocation, %s placement\n", VariantName(config).c_str(),
+           config.checks ? "" : " (production: scan validation only)",
+           TileAllocationName(config.allocation), PlacementName(config.placement));
+    if (options.noise.kind != NoiseKind::None) {
+        printf("%s noise on %u threads\n", NoiseKindName(options.noise.kind),
+               options.noise.threads);
+    }
+    if (options.perfCounters) {
+        printf("hardware counters per trial in %s; see resultsTool summary\n",
+               options.resultsPath);
+    }
+    printf("settings: %s\n", options.settings.c_str());
+}
+
+// Batched and clustered allocation hand a worker several tile IDs before it starts any. With more
+// runnable workers than CPUs and a wait that never yields, a worker descheduled on unstarted tiles
+// leaves every successor spinning for its whole time slice, and a trial takes seconds instead of
+// milliseconds (51.8 s against 0.016 s with bump for 4 workers on 1 CPU).
+static void WarnIfOversubscribed(const RunOptions& options) {
+    const CpuConfig& config = options.config;
+    const bool spins =
+        config.waitPolicy == WaitPolicy::Spin || config.waitPolicy == WaitPolicy::Pause;
+    if (config.allocation == TileAllocation::Bump || !spins) {
+        return;
+    }
+    const size_t cpus = std::max<size_t>(1, AllowedCpus().size() / options.shards);
+    const uint64_t runnable = (uint64_t)config.workerCount * options.concurrentTrials;
+    if (runnable > cpus) {
+        printf("Warning: %llu workers with %s allocation and %s waits, but %zu CPU%s%s; a worker "
+               "descheduled on granted tiles stalls its successors for a time slice. Use "
+               "--wait=backoff or park, or fewer workers.\n",
+               (unsigned long long)runnable, TileAllocationName(config.allocation),
+               WaitPolicyName(config.waitPolicy), cpus, cpus == 1 ? "" : "s",
+               options.shards > 1 ? " per shard" : "");
+    }
+}
+
+// One line, so a script can take the last line of the output.
+static void PrintJsonReport(const RunOptions& options, const CampaignState& state) {
+    printf("{\"backend\":\"cpu\",\"settings\":\"%s\",\"trials\":%u,\"attempted\":%u,"
+           "\"passed\":%u,\"first_failure\":%u,\"seconds\":%.3f,\"failing\":[",
+           options.settings.c_str(), state.batchSize, state.attempted, state.passed,
+           state.firstFailure, state.seconds);
+    for (uint32_t i = 0; i < state.failingCount; ++i) {
+        printf("%s{\"trial\":%u,\"seed\":\"0x%016llX\"}", i ? "," : "", state.failing[i].trial,
+               (unsigned long long)state.failing[i].seed);
+    }
+    printf("]}\n");
+}
+
+// Portable driver for the CPU backend. Takes the same options as the Metal harness in main.m,
+// plus how many trials to run at once, how many emulated workgroups each trial gets and how they
+// are scheduled. Returns whether every trial ran and passed.
+static bool run(const RunOptions& options) {
+    CampaignState state;
+    if (options.resume && options.shards > 1) {
+        printf("A sharded campaign is not checkpointed, so it cannot be resumed.\n");
+        return false;
+    }
+    WarnIfOversubscribed(options);
+    if (options.perfCounters && !options.resultsPath) {
+        printf("--perf records its counters in the results store; give --results too.\n");
+        return false;
+    }
+    if (options.perfCounters) {
+        const PerfCounters probe;
+        if (!probe.Available()) {
+            printf("perf events are not available here; the counters are recorded as 0.\n");
+        }
+        for (uint32_t e = 0; probe.Available() && e < static_cast<uint32_t>(PerfEvent::Count);
+             ++e) {
+            if (!probe.Available(static_cast<PerfEvent>(e))) {
+                printf("perf event %s is not available here; it is recorded as 0.\n",
+                       PerfEventName(static_cast<PerfEvent>(e)));
+            }
+        }
+    }
+    if (options.resume) {
+        if (!LoadCheckpoint(options.checkpointPath, &state)) {
+            return false;
+        }
+        if (options.settings != state.config || options.trials != state.batchSize) {
+            printf("%s is a checkpoint of --trials=%u %s; rerun with those options.\n",
+                   options.checkpointPath, state.batchSize, state.config);
+            return false;
+        }
+        printf("Resuming at trial %u of %u (%u passed in %.3f s).\n", state.nextTrial,
+               state.batchSize, state.passed, state.seconds);
+    } else if (options.settings.size() >= sizeof(state.config)) {
+        printf("The settings do not fit in a checkpoint.\n");
+        return false;
+    } else {
+        snprintf(state.config, sizeof(state.config), "%s", options.settings.c_str());
+        state.batchSize = options.trials;
+    }
+
+    ResultsWriter results;
+    TrialSinks sinks;
+    if (options.resultsPath) {
+        if (!results.Open(options.resultsPath) ||
+            !results.ConfigId(HostName() + " " + options.settings, &sinks.configId)) {
+            return false;
+        }
+        sinks.results = &results;
+    }
+    if (options.shards > 1) {
+        // Forked before this process starts any thread, such as the failure writer's.
+        ShardOptions shardOptions;
+        shardOptions.shards = options.shards;
+        shardOptions.trials = options.trials;
+        shardOptions.concurrentTrials = options.concurrentTrials;
+        shardOptions.stallIntervalMs = options.stallIntervalMs;
+        shardOptions.seed = options.seed;
+        shardOptions.failuresPath = options.failuresPath;
+        shardOptions.noise = options.noise;
+        shardOptions.perfCounters = options.perfCounters;
+        if (!RunShards(options.config, shardOptions, sinks.results, sinks.configId, &state)) {
+            return false;
+        }
+    } else {
+        FailureWriter writer(options.failuresPath);
+        sinks.failures = &writer;
+        NoiseGenerator noise(options.noise);
+        TrialRunner runner(options.config, options.concurrentTrials, options.seed,
+                           options.perfCounters);
+        if (!RunCampaign(runner, options, sinks, state)) {
+            return false;
+        }
+    }
+    if (options.report == ReportFormat::Json) {
+        PrintJsonReport(options, state);
+    } else {
+        PrintTextReport(options, state);
+    }
+    return !state.firstFailure;
+}
+
+static void ListVariants() {
+    const std::vector<std::string> names = CompiledVariantNames();
+    printf("%zu specialized stress kernels (layout/order/split/wait/mode), selected with\n"
+           "--kernel=specialized:\n",
+           names.size());
+    for (const std::string& name : names) {
+        printf("  %s\n", name.c_str());
+    }
+    printf("and one generic kernel, --kernel=dynamic, that reads every option at run time.\n");
+}
+
+static bool ParseKernel(const char* arg, bool* specialized) {
+    if (strcmp(arg, "specialized") && strcmp(arg, "dynamic")) {
+        return false;
+    }
+    *specialized = !strcmp(arg, "specialized");
+    return true;
+}
+
+static bool ParseMode(const char* arg, bool* checks) {
+    if (strcmp(arg, "checked") && strcmp(arg, "production")) {
+        return false;
+    }
+    *checks = !strcmp(arg, "checked");
+    return true;
+}
+
+int main(int argc, const char* argv[]) {
+    RunOptions options;
+    CpuConfig& config = options.config;
+    config.workerCount = std::max(1u, std::thread::hardware_concurrency());
+    options.noise.threads = config.workerCount;
+    bool listVariants = false;
+    bool help = false;
+
+    // Registered in the order of the positional arguments of earlier versions; the options
+    // without a position follow the ones they belong with.
+    CommandLine cli;
+    cli.Add("backend", "cpu", "cpu", "Backend; this harness runs only the CPU one.",
+            [](const char* v) {
+                if (!strcmp(v, "metal")) {
+                    printf("The Metal backend is metalMinRepro.\n");
+                }
+                return !strcmp(v, "cpu");
+            });
+    cli.Add("trials", "n", "1", "Trials to run, up to 2^32 - 2.",
+            [&](const char* v) { return ParseUint32(v, 0, UINT32_MAX - 1, &options.trials); },
+            true, false);
+    cli.Add("stall-ms", "ms", "0", "Stall monitor interval; 0 disables it.",
+            [&](const char* v) { return ParseUint32(v, 0, INT32_MAX, &options.stallIntervalMs); },
+            true, false);
+    cli.Add("concurrent", "n", "1", "Independent trials run at once.",
+            [&](const char* v) { return ParseUint32(v, 1, 4096, &options.concurrentTrials); },
+            true);
+    cli.Add("shards", "n", "1",
+            "Worker processes, each on its own CPUs; a sharded run does not stop at a failure.",
+            [&](const char* v) { return ParseUint32(v, 1, 1024, &options.shards); });
+    cli.Add("workers", "n", std::to_string(config.workerCount),
+            "Emulated workgroups (threads) per trial; the default is one per core, or per CPU of "
+            "a shard.",
+            [&](const char* v) { return ParseUint32(v, 1, 4096, &config.workerCount); }, true);
+    cli.Add("layout", "name", "packed", "Scan buffer layout: packed, padded or soa.",
+            [&](const char* v) { return ParseScanLayout(v, &config.layout); }, true);
+    cli.Add("wait", "name", "spin", "Wait policy: spin, pause, backoff or park.",
+            [&](const char* v) { return ParseWaitPolicy(v, &config.waitPolicy); }, true);
+    cli.Add("order", "name", "relaxed", "Memory order: relaxed, acqrel or seqcst.",
+            [&](const char* v) { return ParseMemoryOrder(v, &config.memoryOrder); }, true);
+    cli.Add("tiles-per-scan", "n", std::to_string(TEST_SIZE),
+            "Splits the dispatch into independent scans of this many tiles.",
+            [&](const char* v) { return ParseUint32(v, 1, TEST_SIZE, &config.tilesPerScan); },
+            true);
+    cli.Add("tiles", "n", std::to_string(TEST_SIZE), "Tiles per dispatch.",
+            [&](const char* v) { return ParseUint32(v, 1, TEST_SIZE, &config.tileCount); });
+    cli.Add("algorithm", "name", "chained", "chained or rts (reduce-then-scan).",
+            [&](const char* v) { return ParseScanAlgorithm(v, &config.algorithm); }, true);
+    cli.Add("scheduler", "name", "fair", "Scheduler policy: fair, yield or preempt.",
+            [&](const char* v) { return ParseSchedulerPolicy(v, &config.scheduler); }, true);
+    cli.Add("split", "n", std::to_string(SPLIT_THREADS),
+            "Split lanes per tile: 2, 4 or 8, for 32-, 64- or 128-bit payloads.",
+            [&](const char* v) {
+                return ParseUint32(v, 0, MAX_SPLIT_THREADS, &config.splitThreads) &&
+                       IsValidSplitThreads(config.splitThreads);
+            },
+            true);
+    cli.Add("kernel", "name", "specialized",
+            "specialized (compiled for exactly these options) or dynamic.",
+            [&](const char* v) { return ParseKernel(v, &config.specialized); }, true);
+    cli.Add("mode", "name", "checked",
+            "checked, or production (no in-kernel checks, scan validation only).",
+            [&](const char* v) { return ParseMode(v, &config.checks); }, true);
+    cli.Add("allocation", "name", "bump",
+            "Tile-ID allocation: bump, batched or cluster; see the README.",
+            [&](const char* v) { return ParseTileAllocation(v, &config.allocation); }, true);
+    cli.Add("placement", "name", "none",
+            "Worker pinning: none, compact, scatter, socket or chain; see the README.",
+            [&](const char* v) { return ParsePlacement(v, &config.placement); });
+    const std::string noiseHelp =
+        "Co-runner load during the trials: none, memory, atomic or compute. memory streams "
+        "through one buffer of twice the last-level cache, 16 MiB to 1 GiB (here " +
+        std::to_string(NoiseBufferBytes() >> 20) + " MiB), however many threads.";
+    cli.Add("noise", "kind", "none", noiseHelp.c_str(),
+            [&](const char* v) { return ParseNoiseKind(v, &options.noise.kind); });
+    cli.Add("noise-threads", "n", std::to_string(config.workerCount),
+            "Threads of noise, the intensity; the default is one per core.",
+            [&](const char* v) { return ParseUint32(v, 0, 4096, &options.noise.threads); });
+    cli.Add("seed", "n", "0", "Campaign seed of the scheduler randomness; decimal or 0x hex.",
+            [&](const char* v) { return ParseUint64(v, &options.seed); });
+    cli.Add("results", "file", "", "Appends a record of every trial to this results store.",
+            [&](const char* v) {
+                options.resultsPath = v;
+                return true;
+            },
+            true, false);
+    cli.Add("failures", "file", FAILURE_LOG_PATH, "Where failure records are written.",
+            [&](const char* v) {
+                options.failuresPath = v;
+                return true;
+            },
+            false, false);
+    cli.Add("checkpoint", "file", CHECKPOINT_PATH, "Where a long run checkpoints itself.",
+            [&](const char* v) {
+                options.checkpointPath = v;
+                return true;
+            },
+            false, false);
+    cli.AddSwitch("resume", "Continues the campaign in the checkpoint; give the same settings.",
+                  [&] { options.resume = true; });
+    cli.AddSwitch("perf", "Records hardware counters of each trial's scan passes in --results.",
+                  [&] { options.perfCounters = true; });
+    cli.Add("report", "format", "text", "Final report: text, or json on one line.",
+            [&](const char* v) { return ParseReportFormat(v, &options.report); }, false, false);
+    cli.AddSwitch("list-variants", "Lists the compiled kernel specializations and exits.",
+                  [&] { listVariants = true; });
+    cli.AddSwitch("help", "Prints this and exits.", [&] { help = true; });
+
+    if (argc < 2 || !cli.Parse(argc, argv) || help) {
+        cli.PrintUsage(argv[0]);
+        printf("A run that lasts longer than %u s checkpoints itself every %u s.\n",
+               CHECKPOINT_INTERVAL_S, CHECKPOINT_INTERVAL_S);
+        return help ? 0 : 1;
+    }
+    if (listVariants) {
+        ListVariants();
+        return 0;
+    }
+    // A shard runs on its share of the CPUs only, so one worker per core would oversubscribe
+    // them shards-fold. The smallest share sets the default, as every shard runs the same config.
+    if (options.shards > 1) {
+        size_t shardCpus = SIZE_MAX;
+        for (uint32_t s = 0; s < options.shards; ++s) {
+            shardCpus = std::min(shardCpus, ShardCpus(s, options.shards).size());
+        }
+        cli.SetDefault("workers", std::to_string(shardCpus));
+    }
+    options.settings = cli.Settings();
+    const bool passed = run(options);
+    if (passed && options.report == ReportFormat::Text) {
+        printf("All batches completed.\n");
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "cpuBackend.h"
+#include "perfCounters.h"
+#include "placement.h"
+
+// Unit tests for the CPU backend: parts that can be checked without the machine they are meant
+// for, such as placement on a made-up multi-socket topology, and the hardware counters where the
+// host has them. Each test prints what went wrong and returns false; the program exits with 1 if
+// any did.
+
+// Fails the enclosing test, printing the condition, when it does not hold.
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            printf("  %s:%d: %s does not hold\n", __FILE__, __LINE__, #condition); \
+            return false;                                                           \
+        }                                                                           \
+    } while (0)
+
+// packages sockets of cores cores each, one hardware thread per core and one last-level cache
+// per socket, numbered socket by socket.
+static std::vector<CpuLocation> MadeUpTopology(uint32_t packages, uint32_t cores) {
+    std::vector<CpuLocation> cpus;
+    for (uint32_t p = 0; p < packages; ++p) {
+        for (uint32_t c = 0; c < cores; ++c) {
+            const uint32_t cpu = p * cores + c;
+            cpus.push_back({cpu, p, p, p, cpu, 0});
+        }
+    }
+    return cpus;
+}
+
+// Four concurrent trials of two workers on two sockets of four cores: each trial on one socket,
+// the trials alternating between them, and no CPU given to two trials.
+static bool TestSocketPlacement() {
+    const std::vector<CpuLocation> topology = MadeUpTopology(2, 4);
+    std::set<uint32_t> taken;
+    for (uint32_t slot = 0; slot < 4; ++slot) {
+        const std::vector<CpuLocation> placed = PlaceWorkers(Placement::Socket, 2, slot, topology);
+        CHECK(placed.size() == 2);
+        for (const CpuLocation& cpu : placed) {
+            CHECK(cpu.package == slot % 2);
+            CHECK(taken.insert(cpu.cpu).second);
+        }
+    }
+    CHECK(taken.size() == topology.size());
+    // A fifth trial finds both sockets full and wraps to the first CPUs of its socket.
+    const std::vector<CpuLocation> wrapped = PlaceWorkers(Placement::Socket, 2, 4, topology);
+    CHECK(wrapped.size() == 2 && wrapped[0].cpu == 0 && wrapped[1].cpu == 1);
+    return true;
+}
+
+// Consecutive trials of several workers count what each of them ran. Exited workers fold their
+// counts into the group, so counts that are not taken as differences are running totals: a short
+// trial after two long ones would count more than either. Passes without checking where perf
+// events are not available.
+static bool TestPerfCountsPerTrial() {
+    PerfCounters perf;
+    if (!perf.Available()) {
+        printf("  perf events are not available here; not checked\n");
+        return true;
+    }
+    // Several workers, but no more than the cores, so a trial's count does not depend much on how
+    // the scheduler interleaved them.
+    CpuConfig config;
+    config.workerCount = std::min(4u, std::max(2u, std::thread::hardware_concurrency()));
+    config.waitPolicy = WaitPolicy::Park;
+    CpuBackend full(config);
+    config.tileCount = 64;
+    CpuBackend small(config);
+
+    full.DispatchKernels(0, &perf);  // Warm up.
+    uint64_t counts[3];
+    CpuBackend* trials[3] = {&full, &full, &small};
+    for (uint32_t i = 0; i < 3; ++i) {
+        trials[i]->DispatchKernels(0, &perf);
+        counts[i] = perf.Get(PerfEvent::Instructions);
+    }
+    CHECK(counts[0] > 0 && counts[1] > 0);
+    CHECK(counts[1] < 4 * counts[0] && counts[0] < 4 * counts[1]);
+    CHECK(counts[2] < std::min(counts[0], counts[1]) / 4);
+    return true;
+}
+
+struct Test {
+    const char* name;
+    bool (*run)();
+};
+
+static const Test TESTS[] = {
+    {"socket-placement", TestSocketPlacement},
+    {"perf-counts-per-trial", TestPerfCountsPerTrial},
+};
+
+int main(int argc, const char* argv[]) {
+    uint32_t failed = 0;
+    uint32_t ran = 0;
+    for (const Test& test : TESTS) {
+        if (argc > 1 && strcmp(argv[1], test.name)) {
+            continue;
+        }
+        const bool passed = test.run();
+        printf("%-24s %s\n", test.name, passed ? "ok" : "FAILED");
+        failed += !passed;
+        ++ran;
+    }
+    if (!ran) {
+        printf("Usage: %s [test]\nTests:\n", argv[0]);
+        for (const Test& test : TESTS) {
+            printf("  %s\n", test.name);
+        }
+        return 1;
+    }
+    printf("%u of %u tests passed\n", ran - failed, ran);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+#include "failureLog.h"
+
+#include <utility>
+
+#include "common.h"
+
+namespace {
+
+const char* const FAILURE_KIND_NAMES[] = {"scan",        "message", "shuffle_ready",
+                                          "shuffle_inc", "sg_size", "unknown"};
+
+// What each kind of failure means, printed under the first summary that contains one.
+const char* const FAILURE_KIND_EXPLANATIONS[] = {
+    "The final scan value of the word is wrong. Word w of tile k should be "
+    "1024 * (w + 1) * (k % tilesPerScan + 1).",
+    "A lookback read a scan word that was neither NOT_READY, READY with this lane's half of the "
+    "tile reduction, nor INCLUSIVE.",
+    "The prefix gathered during a READY phase was not (tile_id - lookback_id) * 1024 * (w + 1) "
+    "for the first wrong word w.",
+    "The prefix gathered during an INCLUSIVE phase was not tile_id * 1024 * (w + 1) for the "
+    "first wrong word w.",
+    "The kernel ran with a simdgroup size other than BLOCK_DIM (got is the size it saw); it is "
+    "logged at tile 0, lane 0.",
+    "The kernel posted an error code this host does not know.",
+};
+
+}  // namespace
+
+const char* FailureKindName(FailureKind kind) {
+    return FAILURE_KIND_NAMES[static_cast<uint32_t>(kind)];
+}
+
+const char* ScanFlagName(uint32_t word) {
+    switch (word & FLAG_MASK) {
+        case FLAG_NOT_READY:
+            return "not_ready";
+        case FLAG_READY:
+            return "ready";
+        case FLAG_INCLUSIVE:
+            return "inclusive";
+        default:
+            return "invalid";
+    }
+}
+
+void FailureList::Reset(uint32_t trialIndex) {
+    trial = trialIndex;
+    dropped = 0;
+    records.clear();
+}
+
+void FailureList::Add(FailureKind kind, uint32_t tile, uint32_t lane, uint32_t got,
+                      uint32_t expected, uint32_t raw0, uint32_t raw1) {
+    if (records.size() >= MAX_FAILURE_RECORDS) {
+        dropped++;
+        return;
+    }
+    records.push_back({trial, kind, tile, lane, got, expected, {raw0, raw1}});
+}
+
+FailureWriter::FailureWriter(std::string path)
+    : path(std::move(path)), thread(&FailureWriter::Run, this) {}
+
+FailureWriter::~FailureWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_one();
+    thread.join();
+    if (file) {
+        fclose(file);
+    }
+}
+
+void FailureWriter::Submit(FailureList& list) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(list));
+    }
+    ready.notify_one();
+    list.Reset(list.trial);
+}
+
+void FailureWriter::Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        ready.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        FailureList list = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        Write(list);
+        lock.lock();
+    }
+}
+
+void FailureWriter::Write(const FailureList& list) {
+    if (!file) {
+        file = fopen(path.c_str(), "w");
+        if (!file) {
+            printf("Failed to open %s; failure records are only summarized.\n", path.c_str());
+        }
+    }
+
+    uint32_t counts[static_cast<uint32_t>(FailureKind::Count)] = {};
+    const FailureRecord* first[static_cast<uint32_t>(FailureKind::Count)] = {};
+    for (const FailureRecord& r : list.records) {
+        const uint32_t k = static_cast<uint32_t>(r.kind);
+        if (!counts[k]++) {
+            first[k] = &r;
+        }
+        if (!file) {
+            continue;
+        }
+        if (r.kind == FailureKind::Scan) {
+            fprintf(file,
+                    "{\"trial\":%u,\"kind\":\"%s\",\"tile\":%u,\"lane\":%u,\"word\":%u,"
+                    "\"got\":%u,\"expected\":%u,\"raw\":[%u,%u],\"flags\":[\"%s\",\"%s\"]}\n",
+                    r.trial, FailureKindName(r.kind), r.tile, r.lane, r.lane / 2, r.got,
+                    r.expected, r.raw[0], r.raw[1], ScanFlagName(r.raw[0]),
+                    ScanFlagName(r.raw[1]));
+        } else {
+            fprintf(file,
+                    "{\"trial\":%u,\"kind\":\"%s\",\"tile\":%u,\"lane\":%u,\"code\":%u,"
+                    "\"got\":%u,\"value\":%u,\"flags\":\"%s\"}\n",
+                    r.trial, FailureKindName(r.kind), r.tile, r.lane, r.raw[0], r.got,
+                    r.got & VALUE_MASK, ScanFlagName(r.got));
+        }
+    }
+    if (file) {
+        fflush(file);
+    }
+
+    printf("Trial %u: %zu failure records", list.trial, list.records.size());
+    if (file) {
+        printf(" in %s", path.c_str());
+    }
+    if (list.dropped) {
+        printf(" (%u more dropped)", list.dropped);
+    }
+    printf("\n");
+    for (uint32_t k = 0; k < static_cast<uint32_t>(FailureKind::Count); ++k) {
+        if (!counts[k]) {
+            continue;
+        }
+        const FailureRecord& r = *first[k];
+        if (r.kind == FailureKind::Scan) {
+            printf("  %-13s %6u, first at tile %u word %u: got %u, expected %u (%s, %s)\n",
+                   FailureKindName(r.kind), counts[k], r.tile, r.lane / 2, r.got, r.expected,
+                   ScanFlagName(r.raw[0]), ScanFlagName(r.raw[1]));
+        } else {
+            printf("  %-13s %6u, first at tile %u lane %u: got 0x%08X\n", FailureKindName(r.kind),
+                   counts[k], r.tile, r.lane, r.got);
+        }
+        if (!explained[k]) {
+            printf("    %s\n", FAILURE_KIND_EXPLANATIONS[k]);
+            explained[k] = true;
+        }
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Structured failure reporting. The validators append a FailureRecord per failing tile to the
+// trial's FailureList instead of printing; the harness hands a failed trial's list to a
+// FailureWriter, whose thread writes it as JSON Lines and prints a short summary, so formatting
+// and I/O never run on the thread that starts the next trial.
+
+// What failed. Scan is a wrong final value; the others are the stress kernel's ERROR_TYPE_* codes.
+enum class FailureKind : uint32_t {
+    Scan,
+    MessagePassing,
+    ShuffleReady,
+    ShuffleInclusive,
+    SubgroupSize,
+    Unknown,
+    Count,
+};
+
+const char* FailureKindName(FailureKind kind);
+
+// Name of the flag bits of a scan word: "not_ready", "ready", "inclusive" or "invalid".
+const char* ScanFlagName(uint32_t word);
+
+struct FailureRecord {
+    uint32_t trial;
+    FailureKind kind;
+    uint32_t tile;
+    uint32_t lane;      // Split lane. For Scan, the lane holding the low half of the word.
+    uint32_t got;       // Scan: the rejoined word. Errors: the value the kernel posted.
+    uint32_t expected;  // Scan only.
+    uint32_t raw[2];    // Scan: the low and high lane words, flags included. Errors: code, got.
+};
+
+// At most this many records are kept per trial, as the old validator printed at most 2048
+// mismatches; the rest are only counted.
+const uint32_t MAX_FAILURE_RECORDS = 2048;
+
+// The failures of one trial.
+struct FailureList {
+    uint32_t trial = 0;
+    uint32_t dropped = 0;
+    std::vector<FailureRecord> records;
+
+    // Empties the list for a new trial.
+    void Reset(uint32_t trialIndex);
+    void Add(FailureKind kind, uint32_t tile, uint32_t lane, uint32_t got, uint32_t expected,
+             uint32_t raw0, uint32_t raw1);
+    bool Empty() const { return records.empty() && !dropped; }
+};
+
+// Writes submitted failure lists on a background thread: every record as one JSON object per line
+// to path, opened on the first submission so a passing run leaves no file behind, and a summary
+// per trial to stdout. The destructor writes whatever is still queued before returning.
+class FailureWriter {
+   public:
+    explicit FailureWriter(std::string path);
+    ~FailureWriter();
+
+    FailureWriter(const FailureWriter&) = delete;
+    FailureWriter& operator=(const FailureWriter&) = delete;
+
+    // Queues list for writing and leaves it empty. Never blocks on I/O.
+    void Submit(FailureList& list);
+
+    const std::string& Path() const { return path; }
+
+   private:
+    void Run();
+    void Write(const FailureList& list);
+
+    std::string path;
+    FILE* file = nullptr;
+    bool explained[static_cast<uint32_t>(FailureKind::Count)] = {};
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<FailureList> queue;
+    bool stopping = false;
+    std::thread thread;
+};
+
+// Where the harnesses write failure records.
+const char* const FAILURE_LOG_PATH = "failures.jsonl";
@@ -6,6 +6,17 @@ using namespace metal;
 constant uint BLOCK_DIM = 256;
 constant uint TEST_SIZE = 65535;
 
+// Split threads per tile, as passed to the stress kernel. The scan buffer holds SPLIT_THREADS
+// words per tile and the error buffer one uint2 per split thread.
+constant uint SPLIT_THREADS_ARG [[function_constant(2)]];
+constant uint SPLIT_THREADS =
+    is_function_constant_defined(SPLIT_THREADS_ARG) ? SPLIT_THREADS_ARG : 2;
+
+// In production mode (CHECKS false) the stress kernel never posts an error, so the error buffer is
+// left alone.
+constant bool CHECKS_ARG [[function_constant(3)]];
+constant bool CHECKS = is_function_constant_defined(CHECKS_ARG) ? CHECKS_ARG : true;
+
 kernel void init(uint3 id [[thread_position_in_grid]],
               uint3 griddim [[threadgroups_per_grid]],
               device uint* scan_bump [[buffer(0)]],
@@ -17,12 +28,14 @@ kernel void init(uint3 id [[thread_position_in_grid]],
   }
 
   // Clear scan buffer
-  for (uint i = id.x; i < TEST_SIZE * 2; i += griddim.x * BLOCK_DIM) {
+  for (uint i = id.x; i < TEST_SIZE * SPLIT_THREADS; i += griddim.x * BLOCK_DIM) {
     scan[i] = 0;
   }
 
   // Clear error buffer
-  for (uint i = id.x; i < TEST_SIZE * 4; i += griddim.x * BLOCK_DIM) {
-    errors[i] = 0;
+  if (CHECKS) {
+    for (uint i = id.x; i < TEST_SIZE * SPLIT_THREADS * 2; i += griddim.x * BLOCK_DIM) {
+      errors[i] = 0;
+    }
   }
 }
\ No newline at end of file
@@ -1,18 +1,24 @@
 #import <Metal/Metal.h>
 
-// Must exactly match the shader.
-const uint32_t TEST_SIZE = 65535;
-const uint32_t BLOCK_DIM = 32;
-const uint32_t ERROR_TYPE_MESSAGE = 1u;
-const uint32_t ERROR_TYPE_SHUFFLE_READY = 2u;
-const uint32_t ERROR_TYPE_SHUFFLE_INC = 3u;
-const uint32_t ERROR_TYPE_SGSIZE = 4u;
-const uint32_t FLAG_NOT_READY = 0u;
-const uint32_t FLAG_READY = 0x40000000u;
-const uint32_t FLAG_INCLUSIVE = 0x80000000u;
-const uint32_t VALUE_MASK = 0xFFFFu;
-
-static bool SetupPipelineStates(id<MTLDevice> device, id<MTLComputePipelineState>* outInitPSO,
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "checkpoint.h"
+#include "commandLine.h"
+#include "common.h"
+#include "resultsStore.h"
+#include "stallMonitor.h"
+#include "trialGraph.h"
+
+// Builds the init and stress pipelines specialized for these options. Each distinct combination is
+// its own compiled kernel; the options are Metal function constants 0-4, so nothing is branched on
+// at run time. progress adds the counters the stall monitor polls.
+static bool SetupPipelineStates(id<MTLDevice> device, MemoryOrder memoryOrder,
+                                uint32_t tilesPerScan, uint32_t splitThreads, bool checks,
+                                bool progress, id<MTLComputePipelineState>* outInitPSO,
                                 id<MTLComputePipelineState>* outStressPSO, NSError** errorPtr) {
     NSURL* initUrl = [NSURL fileURLWithPath:@"initShader.metallib"];
     id<MTLLibrary> initLibrary = [device newLibraryWithURL:initUrl error:errorPtr];
@@ -27,12 +33,23 @@ static bool SetupPipelineStates(id<MTLDevice> device, id<MTLComputePipelineState
         return false;
     }
 
-    id<MTLFunction> initEntry = [initLibrary newFunctionWithName:@"init"];
+    MTLFunctionConstantValues* constants = [MTLFunctionConstantValues new];
+    uint32_t memoryOrderValue = static_cast<uint32_t>(memoryOrder);
+    [constants setConstantValue:&memoryOrderValue type:MTLDataTypeUInt atIndex:0];
+    [constants setConstantValue:&tilesPerScan type:MTLDataTypeUInt atIndex:1];
+    [constants setConstantValue:&splitThreads type:MTLDataTypeUInt atIndex:2];
+    [constants setConstantValue:&checks type:MTLDataTypeBool atIndex:3];
+    [constants setConstantValue:&progress type:MTLDataTypeBool atIndex:4];
+    id<MTLFunction> initEntry = [initLibrary newFunctionWithName:@"init"
+                                                  constantValues:constants
+                                                           error:errorPtr];
     if (initEntry == nil) {
         NSLog(@"Failed to find the init entrypoint function.");
         return false;
     }
-    id<MTLFunction> stressEntry = [stressLibrary newFunctionWithName:@"stress"];
+    id<MTLFunction> stressEntry = [stressLibrary newFunctionWithName:@"stress"
+                                                      constantValues:constants
+                                                               error:errorPtr];
     if (stressEntry == nil) {
         NSLog(@"Failed to find the stress entrypoint function.");
         return false;
@@ -53,56 +70,182 @@ static bool SetupPipelineStates(id<MTLDevice> device, id<MTLComputePipelineState
     return true;
 }
 
-static bool CreateMetalBuffers(id<MTLDevice> device, id<MTLBuffer>* outTransferBuffer,
-                               id<MTLBuffer>* outScanBuffer, id<MTLBuffer>* outScanBumpBuffer,
-                               id<MTLBuffer>* outErrorsBuffer) {
-    *outTransferBuffer = [device newBufferWithLength:(TEST_SIZE * 4 * sizeof(uint32_t))
-                                             options:MTLResourceStorageModeShared];
-    *outScanBuffer = [device newBufferWithLength:(TEST_SIZE * 2 * sizeof(uint32_t))
-                                         options:MTLResourceStorageModePrivate];
-    *outScanBumpBuffer =
-        [device newBufferWithLength:(sizeof(uint32_t)) options:MTLResourceStorageModePrivate];
-    *outErrorsBuffer = [device newBufferWithLength:(TEST_SIZE * 4 * sizeof(uint32_t))
-                                           options:MTLResourceStorageModePrivate];
+// Everything a trial graph refers to, resolved once: the pipeline of every compute stage and the
+// buffer behind every GraphBuffer. Compute stages bind buffer b at index b.
+struct GraphResources {
+    id<MTLComputePipelineState> pipelines[static_cast<uint32_t>(StageKind::Count)];
+    id<MTLBuffer> buffers[static_cast<uint32_t>(GraphBuffer::Count)];
 
-    if (!*outTransferBuffer || !*outScanBuffer || !*outScanBumpBuffer || !*outErrorsBuffer) {
-        NSLog(@"Failed to create one or more Metal buffers.");
+    id<MTLComputePipelineState>& Pipeline(StageKind kind) {
+        return pipelines[static_cast<uint32_t>(kind)];
+    }
+    id<MTLBuffer>& Buffer(GraphBuffer buffer) { return buffers[static_cast<uint32_t>(buffer)]; }
+};
+
+// The three passes of the reduce-then-scan baseline, from reduceScanShader.metallib.
+static bool SetupReduceThenScanStates(id<MTLDevice> device, GraphResources* resources,
+                                      NSError** errorPtr) {
+    NSURL* url = [NSURL fileURLWithPath:@"reduceScanShader.metallib"];
+    id<MTLLibrary> library = [device newLibraryWithURL:url error:errorPtr];
+    if (library == nil) {
+        NSLog(@"Failed to load the reduce-then-scan library: %@.",
+              (*errorPtr).localizedDescription);
         return false;
     }
+
+    NSString* const names[] = {@"reduce", @"scanReductions", @"downsweep"};
+    const StageKind kinds[] = {StageKind::Reduce, StageKind::ScanReductions, StageKind::Downsweep};
+    for (int i = 0; i < 3; ++i) {
+        id<MTLFunction> entry = [library newFunctionWithName:names[i]];
+        if (entry == nil) {
+            NSLog(@"Failed to find the %@ entrypoint function.", names[i]);
+            return false;
+        }
+        id<MTLComputePipelineState>& pso = resources->Pipeline(kinds[i]);
+        pso = [device newComputePipelineStateWithFunction:entry error:errorPtr];
+        if (pso == nil) {
+            NSLog(@"Failed to create %@ pipeline state object, error %@.", names[i],
+                  (*errorPtr).localizedDescription);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool CreateMetalBuffers(id<MTLDevice> device, uint32_t splitThreads,
+                               GraphResources* resources) {
+    // The error buffer holds a uint2 per split thread per tile. On a unified-memory device the
+    // scan and error buffers are shared and the validators read them in place. Otherwise they are
+    // private, and each gets a shared copy of its own so both blits go in the same command buffer.
+    const NSUInteger scanBytes = TEST_SIZE * splitThreads * sizeof(uint32_t);
+    const NSUInteger errorBytes = scanBytes * 2;
+    const bool zeroCopy = device.hasUnifiedMemory;
+    const MTLResourceOptions deviceStorage =
+        zeroCopy ? MTLResourceStorageModeShared : MTLResourceStorageModePrivate;
+    if (!zeroCopy) {
+        resources->Buffer(GraphBuffer::ScanCopy) =
+            [device newBufferWithLength:scanBytes options:MTLResourceStorageModeShared];
+        resources->Buffer(GraphBuffer::ErrorsCopy) =
+            [device newBufferWithLength:errorBytes options:MTLResourceStorageModeShared];
+    }
+    resources->Buffer(GraphBuffer::Scan) = [device newBufferWithLength:scanBytes
+                                                               options:deviceStorage];
+    resources->Buffer(GraphBuffer::ScanBump) =
+        [device newBufferWithLength:(sizeof(uint32_t)) options:MTLResourceStorageModePrivate];
+    resources->Buffer(GraphBuffer::Errors) = [device newBufferWithLength:errorBytes
+                                                                 options:deviceStorage];
+    // Shared so the host can poll it while the stress kernel is still running.
+    resources->Buffer(GraphBuffer::Progress) =
+        [device newBufferWithLength:(PROGRESS_SIZE * sizeof(uint32_t))
+                            options:MTLResourceStorageModeShared];
+
+    for (uint32_t b = 0; b < static_cast<uint32_t>(GraphBuffer::Count); ++b) {
+        const GraphBuffer buffer = static_cast<GraphBuffer>(b);
+        const bool isCopy = buffer == GraphBuffer::ScanCopy || buffer == GraphBuffer::ErrorsCopy;
+        if (!resources->buffers[b] && !(zeroCopy && isCopy)) {
+            NSLog(@"Failed to create one or more Metal buffers.");
+            return false;
+        }
+    }
     return true;
 }
 
-static bool DispatchKernels(id<MTLCommandQueue> commandQueue, id<MTLComputePipelineState> initPSO,
-                            id<MTLComputePipelineState> stressPSO, id<MTLBuffer> scanBumpBuffer,
-                            id<MTLBuffer> scanBuffer, id<MTLBuffer> errorsBuffer,
-                            MTLSize initGridDim, MTLSize initBlockDim, MTLSize stressGridDim,
-                            MTLSize stressBlockDim) {
+// Device buffers the host can read in place, so the graph needs no blit out of them.
+static uint32_t HostVisibleBuffers(GraphResources& resources) {
+    uint32_t visible = 0;
+    for (GraphBuffer buffer : {GraphBuffer::Scan, GraphBuffer::Errors}) {
+        if (resources.Buffer(buffer).storageMode == MTLStorageModeShared) {
+            visible |= BufferBit(buffer);
+        }
+    }
+    return visible;
+}
+
+// Polls the shared progress counters until the command buffer retires. The scan buffer itself may
+// be private, so the report is limited to the counts the kernel has published.
+static void WaitWithStallMonitor(id<MTLCommandBuffer> commandBuffer, id<MTLBuffer> progressBuffer,
+                                 uint32_t stallIntervalMs, uint32_t tileCount) {
+    StallMonitor monitor(stallIntervalMs, tileCount);
+    const volatile uint32_t* progress = (const volatile uint32_t*)progressBuffer.contents;
+    while (commandBuffer.status < MTLCommandBufferStatusCompleted) {
+        std::this_thread::sleep_for(monitor.PollPeriod());
+        const ProgressSnapshot snapshot = {progress[PROGRESS_INCLUSIVE], progress[PROGRESS_POSTED]};
+        if (monitor.Observe(snapshot)) {
+            PrintStallReport(snapshot, stallIntervalMs, tileCount);
+        }
+    }
+}
+
+// Encodes every device stage of the graph into a single command buffer and blocks until it
+// retires. Consecutive compute stages share one concurrent encoder, with a buffer barrier only
+// where the graph moves to a new level; consecutive copies share one blit encoder. The stall
+// monitor watches the run if a stage posts progress.
+static bool DispatchGraph(id<MTLCommandQueue> commandQueue, const TrialGraph& graph,
+                          GraphResources& resources, uint32_t stallIntervalMs) {
     id<MTLCommandBuffer> commandBuffer = [commandQueue commandBuffer];
     if (commandBuffer == nil) {
         NSLog(@"Failed to create the command buffer for dispatch.");
         return false;
     }
 
-    id<MTLComputeCommandEncoder> computeEncoder = [commandBuffer computeCommandEncoder];
-    if (computeEncoder == nil) {
-        NSLog(@"Failed to create the command encoder for dispatch.");
-        return false;
+    id<MTLComputeCommandEncoder> computeEncoder = nil;
+    id<MTLBlitCommandEncoder> blitEncoder = nil;
+    uint32_t level = 0;
+    for (uint32_t i = 0; i < graph.StageCount(); ++i) {
+        const GraphStage& stage = graph.Stage(i);
+        if (stage.queue == StageQueue::Compute) {
+            if (blitEncoder != nil) {
+                [blitEncoder endEncoding];
+                blitEncoder = nil;
+            }
+            if (computeEncoder == nil) {
+                computeEncoder =
+                    [commandBuffer computeCommandEncoderWithDispatchType:MTLDispatchTypeConcurrent];
+                if (computeEncoder == nil) {
+                    NSLog(@"Failed to create the command encoder for dispatch.");
+                    return false;
+                }
+            } else if (stage.level != level) {
+                [computeEncoder memoryBarrierWithScope:MTLBarrierScopeBuffers];
+            }
+            level = stage.level;
+            [computeEncoder setComputePipelineState:resources.Pipeline(stage.kind)];
+            for (uint32_t b = 0; b < static_cast<uint32_t>(GraphBuffer::Count); ++b) {
+                if (stage.bindings & 1u << b) {
+                    [computeEncoder setBuffer:resources.buffers[b] offset:0 atIndex:b];
+                }
+            }
+            [computeEncoder dispatchThreadgroups:MTLSizeMake(stage.groups, 1, 1)
+                           threadsPerThreadgroup:MTLSizeMake(stage.groupSize, 1, 1)];
+        } else if (stage.queue == StageQueue::Copy) {
+            if (computeEncoder != nil) {
+                [computeEncoder endEncoding];
+                computeEncoder = nil;
+            }
+            if (blitEncoder == nil) {
+                blitEncoder = [commandBuffer blitCommandEncoder];
+                if (blitEncoder == nil) {
+                    NSLog(@"Failed to create the blit encoder for %s.", StageKindName(stage.kind));
+                    return false;
+                }
+            }
+            id<MTLBuffer> source = resources.Buffer(stage.source);
+            [blitEncoder copyFromBuffer:source
+                           sourceOffset:0
+                               toBuffer:resources.Buffer(stage.destination)
+                      destinationOffset:0
+                                   size:source.length];
+        }
     }
-
-    [computeEncoder setComputePipelineState:initPSO];
-    [computeEncoder setBuffer:scanBumpBuffer offset:0 atIndex:0];
-    [computeEncoder setBuffer:scanBuffer offset:0 atIndex:1];
-    [computeEncoder setBuffer:errorsBuffer offset:0 atIndex:2];
-    [computeEncoder dispatchThreadgroups:initGridDim threadsPerThreadgroup:initBlockDim];
-
-    [computeEncoder setComputePipelineState:stressPSO];
-    [computeEncoder setBuffer:scanBumpBuffer offset:0 atIndex:0];
-    [computeEncoder setBuffer:scanBuffer offset:0 atIndex:1];
-    [computeEncoder setBuffer:errorsBuffer offset:0 atIndex:2];
-    [computeEncoder dispatchThreadgroups:stressGridDim threadsPerThreadgroup:stressBlockDim];
-
     [computeEncoder endEncoding];
+    [blitEncoder endEncoding];
+
+    id<MTLBuffer> progressBuffer = resources.Buffer(GraphBuffer::Progress);
+    memset(progressBuffer.contents, 0, PROGRESS_SIZE * sizeof(uint32_t));
     [commandBuffer commit];
+    if (stallIntervalMs && graph.ReportsProgress()) {
+        WaitWithStallMonitor(commandBuffer, progressBuffer, stallIntervalMs, graph.TileCount());
+    }
     [commandBuffer waitUntilCompleted];
 
     if (commandBuffer.error) {
@@ -117,232 +260,390 @@ static bool DispatchKernels(id<MTLCommandQueue> commandQueue, id<MTLComputePipel
     return true;
 }
 
-// Sanity checks the scan
-static bool ValidateScanBuffer(id<MTLCommandQueue> commandQueue, id<MTLBuffer> scanBuffer,
-                               id<MTLBuffer> transferBuffer) {
-    id<MTLCommandBuffer> commandBuffer = [commandQueue commandBuffer];
-    if (commandBuffer == nil) {
-        NSLog(@"Failed to create the command buffer for scan buffer validation.");
-        return false;
-    }
-
-    id<MTLBlitCommandEncoder> blitEncoder = [commandBuffer blitCommandEncoder];
-    if (blitEncoder == nil) {
-        NSLog(@"Failed to create the blit encoder for scan buffer validation.");
-        return false;
-    }
-
-    [blitEncoder copyFromBuffer:scanBuffer
-                   sourceOffset:0
-                       toBuffer:transferBuffer
-              destinationOffset:0
-                           size:TEST_SIZE * 2 * sizeof(uint32_t)];
-    [blitEncoder endEncoding];
-    [commandBuffer commit];
-    [commandBuffer waitUntilCompleted];
-
-    uint32_t* scan = transferBuffer.contents;
-    uint32_t errs = 0;
-    const uint32_t errLimit = 2048;
-    for (uint32_t k = 0; k < TEST_SIZE; ++k) {
-        uint32_t index = k * 2;
-        uint32_t rejoinedVal = (scan[index] & 0xffff) | (scan[index + 1] << 16);
-        uint32_t flag0 = scan[index] & (FLAG_READY | FLAG_INCLUSIVE);
-        uint32_t flag1 = scan[index] & (FLAG_READY | FLAG_INCLUSIVE);
-        if (rejoinedVal != 1024 * (k + 1)) {
-            NSLog(@"Test failed: got %u at %u (flags: 0x%x, 0x%x)\n",
-                  rejoinedVal, k, flag0, flag1);
-            errs++;
+// Must exactly match noiseShader.metal.
+const uint32_t NOISE_GROUP_SIZE = 256;
+const NSUInteger NOISE_BUFFER_BYTES = (NSUInteger)16 << 24;
+
+// The co-runner; see noiseShader.metal. A host thread keeps two noise dispatches in flight on a
+// queue of its own, so the GPU always has noise to schedule next to the trial's stages.
+class NoiseRunner {
+   public:
+    ~NoiseRunner() { Stop(); }
+
+    // Prints the reason and returns false if the noise pipeline cannot be built.
+    bool Start(id<MTLDevice> device, NoiseKind kind, uint32_t groups, NSError** errorPtr) {
+        NSString* const names[] = {nil, @"noiseMemory", @"noiseAtomic", @"noiseCompute"};
+        if (kind == NoiseKind::None || groups == 0) {
+            return true;
         }
-        if (errs > errLimit) {
-            break;
+        NSURL* url = [NSURL fileURLWithPath:@"noiseShader.metallib"];
+        id<MTLLibrary> library = [device newLibraryWithURL:url error:errorPtr];
+        if (library == nil) {
+            NSLog(@"Failed to load the noise library: %@.", (*errorPtr).localizedDescription);
+            return false;
         }
-    }
-    return errs == 0;
-}
-
-bool CheckError(uint32_t errCode, uint32_t got, uint32_t tile_id, uint32_t tid) {
-    if (!errCode) {
+        NSString* name = names[static_cast<uint32_t>(kind)];
+        id<MTLFunction> entry = [library newFunctionWithName:name];
+        if (entry == nil) {
+            NSLog(@"Failed to find the %@ entrypoint function.", name);
+            return false;
+        }
+        pipeline = [device newComputePipelineStateWithFunction:entry error:errorPtr];
+        queue = [device newCommandQueue];
+        data = [device newBufferWithLength:NOISE_BUFFER_BYTES
+                                   options:MTLResourceStorageModePrivate];
+        counters = [device newBufferWithLength:64 options:MTLResourceStorageModePrivate];
+        if (pipeline == nil || queue == nil || data == nil || counters == nil) {
+            NSLog(@"Failed to create the noise pipeline, queue or buffers.");
+            return false;
+        }
+        this->groups = groups;
+        thread = std::thread([this] { Run(); });
         return true;
     }
 
-    if (errCode == ERROR_TYPE_MESSAGE) {
-        uint32_t val_content_for_ready_state = (1024u >> (tid * 16u)) & VALUE_MASK;
-        uint32_t expected_full_value_for_ready_state = val_content_for_ready_state | FLAG_READY;
-
-        printf(
-            "Message Passing type error at tile %u, thread %u: GOT 0x%08X.\n"
-            "  Expected patterns include:\n"
-            "    1. 0x%08X (NOT_READY)\n"
-            "    2. 0x%08X (READY state: value 0x%04X combined with READY flag for this thread)\n"
-            "    3. (value & 0x%04X) | 0x%08X (INCLUSIVE state: some value derived from lookback "
-            "combined with INCLUSIVE flag for this thread)\n",
-            tile_id, tid, got, FLAG_NOT_READY, expected_full_value_for_ready_state,
-            val_content_for_ready_state, VALUE_MASK, FLAG_INCLUSIVE);
-        return false;
-    } else if (errCode == ERROR_TYPE_SHUFFLE_READY) {
-        printf(
-            "Shuffle Ready error at tile %u, thread %u: GOT 0x%08X (this was 'prev_red' from the "
-            "shader during a READY phase).\n"
-            "  The expected value for 'prev_red' depends on the specific lookback step (tile_id - "
-            "lookback_id) * 1024u.\n",
-            tile_id, tid, got);
-        return false;
-    } else if (errCode == ERROR_TYPE_SHUFFLE_INC) {
-        printf("Shuffle Inclusive error at tile %u, thread %u: GOT 0x%08X (this was 'prev_red' "
-               "from the "
-               "shader during an INCLUSIVE phase).\n"
-               "  The expected value for 'prev_red' should be tile_id * 1024u.\n",
-               tile_id, tid, got);
-        return false;
-    } else if (errCode == ERROR_TYPE_SGSIZE) {
-        printf("Subgroup Size Mismatch error: Expected BLOCK_DIM (%u), but shader reported sgSize "
-               "%u.\n"
-               "  Error logged at effective coordinates: tile %u, thread %u (often 0,0 for this "
-               "type of global check).\n",
-               BLOCK_DIM, got, tile_id, tid);
-        return false;
-    } else {
-        printf("Unknown error code %u detected at tile %u, thread %u: GOT 0x%08X.\n", errCode,
-               tile_id, tid, got);
-        return false;
-    }
-}
-
-bool ValidateErrorBuffer(id<MTLCommandQueue> commandQueue, id<MTLBuffer> errorsBuffer,
-                         id<MTLBuffer> transferBuffer) {
-    id<MTLCommandBuffer> commandBuffer = [commandQueue commandBuffer];
-    if (commandBuffer == nil) {
-        NSLog(@"Failed to create the command buffer for error buffer check.");
-        return false;
-    }
-
-    id<MTLBlitCommandEncoder> blitEncoder = [commandBuffer blitCommandEncoder];
-    if (blitEncoder == nil) {
-        NSLog(@"Failed to create the blit encoder for error buffer check.");
-        return false;
-    }
-
-    [blitEncoder copyFromBuffer:errorsBuffer
-                   sourceOffset:0
-                       toBuffer:transferBuffer
-              destinationOffset:0
-                           size:TEST_SIZE * 4 * sizeof(uint32_t)];
-    [blitEncoder endEncoding];
-    [commandBuffer commit];
-    [commandBuffer waitUntilCompleted];
-
-    uint32_t* error_data_ptr = transferBuffer.contents;
-    for (uint32_t tile_id = 0; tile_id < TEST_SIZE; ++tile_id) {
-        uint32_t index = tile_id * 4;  // Base index for errType (uint2[2]) for this tile_id
-        bool passed = true;
-
-        // First thread's error data
-        uint32_t errCode0 = error_data_ptr[index + 0];
-        uint32_t got_val0 = error_data_ptr[index + 1];
-        if (errCode0 != 0) {
-            if (!CheckError(errCode0, got_val0, tile_id, 0)) {
-                passed = false;
-            }
+    void Stop() {
+        stopping.store(true, std::memory_order_relaxed);
+        if (thread.joinable()) {
+            thread.join();
         }
+    }
 
-        // Second thread's error data
-        uint32_t errCode1 = error_data_ptr[index + 2];
-        uint32_t got_val1 = error_data_ptr[index + 3];
-        if (errCode1 != 0) {
-            if (!CheckError(errCode1, got_val1, tile_id, 1)) {
-                passed = false;
+   private:
+    void Run() {
+        id<MTLCommandBuffer> previous = nil;
+        while (!stopping.load(std::memory_order_relaxed)) {
+            @autoreleasepool {
+                id<MTLCommandBuffer> commandBuffer = [queue commandBuffer];
+                id<MTLComputeCommandEncoder> encoder = [commandBuffer computeCommandEncoder];
+                [encoder setComputePipelineState:pipeline];
+                [encoder setBuffer:data offset:0 atIndex:0];
+                [encoder setBuffer:counters offset:0 atIndex:1];
+                [encoder dispatchThreadgroups:MTLSizeMake(groups, 1, 1)
+                        threadsPerThreadgroup:MTLSizeMake(NOISE_GROUP_SIZE, 1, 1)];
+                [encoder endEncoding];
+                [commandBuffer commit];
+                [previous waitUntilCompleted];
+                previous = commandBuffer;
             }
         }
+        [previous waitUntilCompleted];
+    }
 
-        if (!passed) {
-            return false;
-        }
+    id<MTLCommandQueue> queue = nil;
+    id<MTLComputePipelineState> pipeline = nil;
+    id<MTLBuffer> data = nil;
+    id<MTLBuffer> counters = nil;
+    uint32_t groups = 0;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+// Everything the command line selects.
+struct RunOptions {
+    uint32_t trials = 1;
+    uint32_t stallIntervalMs = 0;
+    MemoryOrder memoryOrder = MemoryOrder::Relaxed;
+    uint32_t tileCount = TEST_SIZE;
+    uint32_t tilesPerScan = TEST_SIZE;
+    ScanAlgorithm algorithm = ScanAlgorithm::Chained;
+    uint32_t splitThreads = SPLIT_THREADS;
+    bool checks = true;
+    NoiseKind noise = NoiseKind::None;
+    uint32_t noiseGroups = 64;
+    const char* resultsPath = nullptr;
+    const char* failuresPath = FAILURE_LOG_PATH;
+    const char* checkpointPath = CHECKPOINT_PATH;
+    bool resume = false;
+    ReportFormat report = ReportFormat::Text;
+    // Every setting as options, echoed into the results store and the checkpoint.
+    std::string settings;
+};
+
+// One line, so a script can take the last line of the output.
+static void PrintJsonReport(const RunOptions& options, const CampaignState& state) {
+    printf("{\"backend\":\"metal\",\"settings\":\"%s\",\"trials\":%u,\"attempted\":%u,"
+           "\"passed\":%u,\"first_failure\":%u,\"seconds\":%.3f,\"failing\":[",
+           options.settings.c_str(), state.batchSize, state.attempted, state.passed,
+           state.firstFailure, state.seconds);
+    for (uint32_t i = 0; i < state.failingCount; ++i) {
+        printf("%s{\"trial\":%u}", i ? "," : "", state.failing[i].trial);
     }
-    return true;
+    printf("]}\n");
 }
 
-void run(uint32_t batchSize) {
+// Returns whether every trial ran and passed.
+static bool run(const RunOptions& options) {
     NSError* error = nil;
     id<MTLDevice> device = MTLCreateSystemDefaultDevice();
     if (!device) {
         NSLog(@"Failed to get default Metal device.");
-        return;
+        return false;
     }
 
-    id<MTLComputePipelineState> initPSO = nil;
-    id<MTLComputePipelineState> stressPSO = nil;
-    if (!SetupPipelineStates(device, &initPSO, &stressPSO, &error)) {
-        return;
+    GraphResources resources = {};
+    if (!SetupPipelineStates(device, options.memoryOrder, options.tilesPerScan,
+                             options.splitThreads, options.checks, options.stallIntervalMs != 0,
+                             &resources.Pipeline(StageKind::Init),
+                             &resources.Pipeline(StageKind::Stress), &error)) {
+        return false;
     }
-
-    id<MTLBuffer> transferBuffer = nil;
-    id<MTLBuffer> scanBuffer = nil;
-    id<MTLBuffer> scanBumpBuffer = nil;
-    id<MTLBuffer> errorsBuffer = nil;
-    if (!CreateMetalBuffers(device, &transferBuffer, &scanBuffer, &scanBumpBuffer, &errorsBuffer)) {
-        return;
+    if (!CreateMetalBuffers(device, options.splitThreads, &resources)) {
+        return false;
+    }
+    if (options.algorithm == ScanAlgorithm::ReduceThenScan &&
+        !SetupReduceThenScanStates(device, &resources, &error)) {
+        return false;
     }
 
     id<MTLCommandQueue> commandQueue = [device newCommandQueue];
     if (commandQueue == nil) {
         NSLog(@"Failed to create the command queue.");
-        return;
+        return false;
     }
 
-    MTLSize initGridDim = MTLSizeMake(256, 1, 1);
-    MTLSize initBlockDim = MTLSizeMake(256, 1, 1);
+    NoiseRunner noise;
+    if (!noise.Start(device, options.noise, options.noiseGroups, &error)) {
+        return false;
+    }
 
-    MTLSize stressGridDim = MTLSizeMake(TEST_SIZE, 1, 1);
-    MTLSize stressBlockDim = MTLSizeMake(32, 1, 1);  // Exactly equal to simdgroup size
+    // Built once; every trial replays it.
+    const TrialGraph graph(GraphOptions{options.algorithm, options.checks,
+                                        HostVisibleBuffers(resources), options.tileCount});
+    auto hostBuffer = [&resources](GraphBuffer buffer) {
+        return (const uint32_t*)resources.Buffer(buffer).contents;
+    };
+    // The device is not a setting, so a checkpoint can be resumed on another Mac; the results
+    // store records it next to the settings.
+    const std::string description = std::string(device.name.UTF8String) + " " + options.settings;
+    // The loop is serial, so every trial ends at a consistent state and a checkpoint can be taken
+    // after any of them; see checkpoint.h.
+    CampaignState state;
+    if (options.resume) {
+        if (!LoadCheckpoint(options.checkpointPath, &state)) {
+            return false;
+        }
+        if (options.settings != state.config || options.trials != state.batchSize) {
+            NSLog(@"%s is a checkpoint of --trials=%u %s; rerun with those options.",
+                  options.checkpointPath, state.batchSize, state.config);
+            return false;
+        }
+        NSLog(@"Resuming at trial %u of %u.", state.nextTrial, state.batchSize);
+    } else if (options.settings.size() >= sizeof(state.config)) {
+        NSLog(@"The settings do not fit in a checkpoint.");
+        return false;
+    } else {
+        snprintf(state.config, sizeof(state.config), "%s", options.settings.c_str());
+        state.batchSize = options.trials;
+    }
+    bool checkpointed = options.resume;
+    auto lastCheckpoint = std::chrono::steady_clock::now();
+
+    FailureWriter writer(options.failuresPath);
+    FailureList failures;
+    // The GPU schedules the workgroups itself, so the records carry no seed and no spin counts.
+    ResultsWriter results;
+    uint32_t configId = 0;
+    if (options.resultsPath) {
+        if (!results.Open(options.resultsPath) ||
+            !results.ConfigId(HostName() + " " + description, &configId)) {
+            return false;
+        }
+    }
 
-    for (uint32_t i = 0; i < batchSize; ++i) {
-        if (!DispatchKernels(commandQueue, initPSO, stressPSO, scanBumpBuffer, scanBuffer,
-                             errorsBuffer, initGridDim, initBlockDim, stressGridDim,
-                             stressBlockDim)) {
+    for (uint32_t i = state.nextTrial - 1; !state.Finished(); ++i) {
+        TrialRecord record;
+        record.startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+        record.trial = i + 1;
+        record.configId = configId;
+        auto start = std::chrono::steady_clock::now();
+        if (!DispatchGraph(commandQueue, graph, resources, options.stallIntervalMs)) {
             NSLog(@"Batch %u: Failed to dispatch kernels.", i + 1);
-            return;
+            return false;
         }
-
-        bool validScan = ValidateScanBuffer(commandQueue, scanBuffer, transferBuffer);
-        if (!validScan) {
+        record.dispatchMs = std::chrono::duration<float, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+
+        // Production mode compiles the checks out; the graph then validates only the scan.
+        failures.Reset(i + 1);
+        start = std::chrono::steady_clock::now();
+        const TrialVerdict verdict =
+            RunHostStages(graph, hostBuffer, options.tilesPerScan, options.splitThreads,
+                          &failures);
+        record.validateMs = std::chrono::duration<float, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+        if (options.resultsPath) {
+            record.failed = (verdict.validScan ? 0 : FAILED_SCAN) |
+                            (verdict.validErrors ? 0 : FAILED_ERRORS);
+            CountFailures(failures, record);
+            results.Append(record);
+        }
+        if (!failures.Empty()) {
+            writer.Submit(failures);
+        }
+        if (!verdict.validScan) {
             NSLog(@"Batch %u: Scan buffer validation FAILED.", i + 1);
         }
-
-        bool validErr = ValidateErrorBuffer(commandQueue, errorsBuffer, transferBuffer);
-        if (!validErr) {
-            NSLog(@"Batch %u: Error buffer check FAILED (errors found and printed).", i + 1);
+        if (!verdict.validErrors) {
+            NSLog(@"Batch %u: Error buffer check FAILED (errors recorded).", i + 1);
         }
 
-        if (!validScan || !validErr) {
-            NSLog(@"Batch %u: FAILED. Exiting test", i + 1);
-            return;
+        state.nextTrial = i + 2;
+        state.attempted++;
+        state.seconds += (record.dispatchMs + record.validateMs) / 1000.0;
+        if (verdict.validScan && verdict.validErrors) {
+            state.passed++;
+        } else {
+            state.firstFailure = i + 1;
+            state.AddFailing(i + 1, 0);
+        }
+        const std::chrono::duration<double> sinceCheckpoint =
+            std::chrono::steady_clock::now() - lastCheckpoint;
+        if (sinceCheckpoint.count() >= CHECKPOINT_INTERVAL_S ||
+            (checkpointed && state.Finished())) {
+            if (!SaveCheckpoint(options.checkpointPath, state)) {
+                return false;
+            }
+            checkpointed = true;
+            lastCheckpoint = std::chrono::steady_clock::now();
         }
     }
 
-    printf("%u / %u ALL TESTS PASSED\n", batchSize, batchSize);
+    noise.Stop();
+    if (options.report == ReportFormat::Json) {
+        PrintJsonReport(options, state);
+    } else if (state.firstFailure) {
+        NSLog(@"Batch %u: FAILED. Exiting test", state.firstFailure);
+    } else {
+        printf("%u / %u ALL TESTS PASSED\n", state.passed, state.batchSize);
+        printf("settings: %s\n", options.settings.c_str());
+    }
+    return !state.firstFailure;
+}
+
+// The pipelines are specialized when the harness starts, so every combination of function
+// constants is available; TILES_PER_SCAN takes any value from 1 to TEST_SIZE.
+static void ListVariants() {
+    printf("Stress kernels are specialized at startup for each combination of\n"
+           "MEMORY_ORDER x SPLIT_THREADS x CHECKS (and any TILES_PER_SCAN):\n");
+    for (uint32_t order = 0; order < static_cast<uint32_t>(MemoryOrder::Count); ++order) {
+        for (uint32_t split = 2; split <= MAX_SPLIT_THREADS; split *= 2) {
+            for (const char* mode : {"checked", "production"}) {
+                printf("  %s/x%u/%s\n", MemoryOrderName(static_cast<MemoryOrder>(order)), split,
+                       mode);
+            }
+        }
+    }
+    printf("plus the reduce-then-scan passes, --algorithm=rts, which take no constants.\n");
 }
 
 int main(int argc, const char* argv[]) {
     @autoreleasepool {
-        if (argc != 2) {
-            NSLog(@"Usage: %s <batchSize>", argv[0]);
-            NSLog(@"batchSize must be a non-negative integer less than 65536.");
-            return 1;
+        RunOptions options;
+        bool listVariants = false;
+        bool help = false;
+
+        // Registered in the order of the positional arguments of earlier versions.
+        CommandLine cli;
+        cli.Add("backend", "metal", "metal", "Backend; the CPU one is cpuMinRepro.",
+                [](const char* v) { return !strcmp(v, "metal"); });
+        cli.Add("trials", "n", "1", "Trials to run, up to 2^32 - 2.",
+                [&](const char* v) {
+                    return ParseUint32(v, 0, UINT32_MAX - 1, &options.trials);
+                },
+                true, false);
+        cli.Add("stall-ms", "ms", "0", "Stall monitor interval; 0 disables it.",
+                [&](const char* v) {
+                    return ParseUint32(v, 0, INT32_MAX, &options.stallIntervalMs);
+                },
+                true, false);
+        cli.Add("order", "name", "relaxed", "Memory order: relaxed, acqrel or seqcst.",
+                [&](const char* v) { return ParseMemoryOrder(v, &options.memoryOrder); }, true);
+        cli.Add("tiles-per-scan", "n", std::to_string(TEST_SIZE),
+                "Splits the dispatch into independent scans of this many tiles.",
+                [&](const char* v) {
+                    return ParseUint32(v, 1, TEST_SIZE, &options.tilesPerScan);
+                },
+                true);
+        cli.Add("tiles", "n", std::to_string(TEST_SIZE), "Tiles (threadgroups) per dispatch.",
+                [&](const char* v) { return ParseUint32(v, 1, TEST_SIZE, &options.tileCount); });
+        cli.Add("algorithm", "name", "chained",
+                "chained or rts (reduce-then-scan; one full-size scan of two split threads).",
+                [&](const char* v) { return ParseScanAlgorithm(v, &options.algorithm); }, true);
+        cli.Add("split", "n", std::to_string(SPLIT_THREADS),
+                "Split lanes per tile: 2, 4 or 8, for 32-, 64- or 128-bit payloads.",
+                [&](const char* v) {
+                    return ParseUint32(v, 0, MAX_SPLIT_THREADS, &options.splitThreads) &&
+                           IsValidSplitThreads(options.splitThreads);
+                },
+                true);
+        cli.Add("mode", "name", "checked",
+                "checked, or production (CHECKS compiled out, scan validation only).",
+                [&](const char* v) {
+                    options.checks = !strcmp(v, "checked");
+                    return options.checks || !strcmp(v, "production");
+                },
+                true);
+        cli.Add("noise", "kind", "none",
+                "Co-runner load on a second queue: none, memory, atomic or compute.",
+                [&](const char* v) { return ParseNoiseKind(v, &options.noise); });
+        cli.Add("noise-groups", "n", "64",
+                "Threadgroups of 256 threads per noise dispatch, the intensity.",
+                [&](const char* v) { return ParseUint32(v, 1, 65535, &options.noiseGroups); });
+        cli.Add("results", "file", "", "Appends a record of every trial to this results store.",
+                [&](const char* v) {
+                    options.resultsPath = v;
+                    return true;
+                },
+                true, false);
+        cli.Add("failures", "file", FAILURE_LOG_PATH, "Where failure records are written.",
+                [&](const char* v) {
+                    options.failuresPath = v;
+                    return true;
+                },
+                false, false);
+        cli.Add("checkpoint", "file", CHECKPOINT_PATH, "Where a long run checkpoints itself.",
+                [&](const char* v) {
+                    options.checkpointPath = v;
+                    return true;
+                },
+                false, false);
+        cli.AddSwitch("resume", "Continues the campaign in the checkpoint; give the same settings.",
+                      [&] { options.resume = true; });
+        cli.Add("report", "format", "text", "Final report: text, or json on one line.",
+                [&](const char* v) { return ParseReportFormat(v, &options.report); }, false,
+                false);
+        cli.AddSwitch("list-variants", "Lists the kernel specializations and exits.",
+                      [&] { listVariants = true; });
+        cli.AddSwitch("help", "Prints this and exits.", [&] { help = true; });
+
+        if (argc < 2 || !cli.Parse(argc, argv) || help) {
+            cli.PrintUsage(argv[0]);
+            printf("A run that lasts longer than %u s checkpoints itself every %u s.\n",
+                   CHECKPOINT_INTERVAL_S, CHECKPOINT_INTERVAL_S);
+            return help ? 0 : 1;
         }
-
-        char* endptr;
-        errno = 0;
-        long batch_val = strtol(argv[1], &endptr, 10);
-
-        if (errno != 0 || endptr == argv[1] || *endptr != '\0' || batch_val < 0 ||
-            batch_val >= 65536) {
-            NSLog(@"Usage: %s <batchSize>", argv[0]);
-            NSLog(@"batchSize must be a non-negative integer less than 65536.");
+        if (listVariants) {
+            ListVariants();
+            return 0;
+        }
+        // The reduce-then-scan shader is written for one scan of TEST_SIZE tiles and two lanes.
+        if (options.algorithm == ScanAlgorithm::ReduceThenScan &&
+            (options.tileCount != TEST_SIZE || options.tilesPerScan != TEST_SIZE ||
+             options.splitThreads != SPLIT_THREADS)) {
+            printf("--algorithm=rts runs only --tiles=%u --tiles-per-scan=%u --split=%u.\n",
+                   TEST_SIZE, TEST_SIZE, SPLIT_THREADS);
             return 1;
         }
-        run((uint32_t)batch_val);
-        NSLog(@"All batches completed.");
+        options.settings = cli.Settings();
+        const bool passed = run(options);
+        if (passed && options.report == ReportFormat::Text) {
+            NSLog(@"All batches completed.");
+        }
+        return passed ? 0 : 1;
     }
-    return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,39 @@
+#include <metal_stdlib>
+using namespace metal;
+
+// The co-runner of the Metal harness: kernels dispatched on a second command queue, back to back,
+// while the trials run, so the stress kernel shares the GPU with a neighbour the way it would in
+// production. Each dispatch does a bounded amount of work and the host keeps resubmitting, so a
+// noise dispatch never holds the GPU for long. The intensity is the threadgroup count.
+
+// Must exactly match the host code.
+constant uint NOISE_GROUP_SIZE = 256;
+constant uint NOISE_BUFFER_WORDS = 1u << 24;  // uint4s: 256 MiB, far beyond the system cache.
+constant uint NOISE_ITERATIONS = 4096;
+
+// Each thread streams read-modify-writes through its stride of the buffer.
+kernel void noiseMemory(uint gid [[thread_position_in_grid]],
+                        uint threads [[threads_per_grid]],
+                        device uint4* data [[buffer(0)]]) {
+    for (uint i = gid; i < NOISE_BUFFER_WORDS; i += threads) {
+        data[i] += 1u;
+    }
+}
+
+// Every thread adds to the same four words, one cache line, like a hot scan_bump.
+kernel void noiseAtomic(uint gid [[thread_position_in_grid]],
+                        device atomic_uint* counters [[buffer(1)]]) {
+    for (uint i = 0; i < NOISE_ITERATIONS; ++i) {
+        atomic_fetch_add_explicit(&counters[gid & 3], 1u, memory_order_relaxed);
+    }
+}
+
+// A dependent arithmetic chain in registers; the store keeps it from being optimized away.
+kernel void noiseCompute(uint gid [[thread_position_in_grid]],
+                         device uint4* data [[buffer(0)]]) {
+    float x = float(gid);
+    for (uint i = 0; i < NOISE_ITERATIONS * 16; ++i) {
+        x = fma(x, 1.0000001f, 0.5f);
+    }
+    data[gid % NOISE_BUFFER_WORDS].x = as_type<uint>(x);
+}
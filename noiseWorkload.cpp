@@ -0,0 +1,79 @@
+#include "noiseWorkload.h"
+
+#include <algorithm>
+
+#include "placement.h"
+
+namespace {
+
+// Words in a cache line, the stride of the memory noise.
+const size_t LINE_WORDS = 64 / sizeof(uint64_t);
+// Work done between checks of the stop flag and updates of the operation count.
+const uint32_t NOISE_BLOCK = 4096;
+
+}  // namespace
+
+size_t NoiseBufferBytes() {
+    return std::min(NOISE_MAX_BYTES,
+                    std::max(NOISE_MIN_BYTES, NOISE_LLC_MULTIPLE * LastLevelCacheBytes()));
+}
+
+NoiseGenerator::NoiseGenerator(const NoiseConfig& config) : config(config) {
+    if (config.kind == NoiseKind::None) {
+        return;
+    }
+    if (config.kind == NoiseKind::Memory && config.threads) {
+        const size_t words = NoiseBufferBytes() / sizeof(uint64_t);
+        // Zeroed, so every page is faulted in before the trials start.
+        buffer.reset(new uint64_t[words]());
+        sliceWords = std::max(LINE_WORDS, words / config.threads / LINE_WORDS * LINE_WORDS);
+    }
+    threads.reserve(config.threads);
+    for (uint32_t t = 0; t < config.threads; ++t) {
+        threads.emplace_back(&NoiseGenerator::Run, this, t);
+    }
+}
+
+NoiseGenerator::~NoiseGenerator() {
+    stopping.store(true, std::memory_order_relaxed);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void NoiseGenerator::Run(uint32_t thread) {
+    size_t cursor = 0;
+    uint64_t x = thread + 1;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        switch (config.kind) {
+            case NoiseKind::Memory: {
+                // One read-modify-write per cache line, so every access misses. Slices are
+                // disjoint, so the threads share the caches but no lines.
+                uint64_t* slice = buffer.get() + thread * sliceWords;
+                for (uint32_t i = 0; i < NOISE_BLOCK; ++i) {
+                    slice[cursor] += 1;
+                    cursor = (cursor + LINE_WORDS) % sliceWords;
+                }
+                break;
+            }
+            case NoiseKind::Atomic:
+                for (uint32_t i = 0; i < NOISE_BLOCK; ++i) {
+                    contended.fetch_add(1, std::memory_order_relaxed);
+                }
+                break;
+            default: {
+                // A dependent multiply-xorshift chain the compiler cannot shorten.
+                for (uint32_t i = 0; i < NOISE_BLOCK; ++i) {
+                    x = x * 6364136223846793005ull + 1442695040888963407ull;
+                    x ^= x >> 29;
+                }
+                break;
+            }
+        }
+        operations.fetch_add(NOISE_BLOCK, std::memory_order_relaxed);
+    }
+    // Keeps the compute chain live.
+    if (x == 0) {
+        operations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+// A co-runner for the CPU backend: extra threads that load the machine the way a neighbouring
+// process would while trials run. The emulated workgroups compete with them for cores, caches and
+// the coherence fabric, so the lookback is exercised under contention rather than on an idle host.
+struct NoiseConfig {
+    NoiseKind kind = NoiseKind::None;
+    uint32_t threads = 0;  // The intensity: how many noise threads run. 0 with any kind is none.
+};
+
+// The memory noise buffer, shared by all its threads: NOISE_LLC_MULTIPLE times the last-level
+// cache this process may use (see LastLevelCacheBytes), so the threads together keep missing in
+// it, within [NOISE_MIN_BYTES, NOISE_MAX_BYTES], and NOISE_MIN_BYTES where the cache size is
+// unknown. The footprint does not grow with the thread count.
+const size_t NOISE_LLC_MULTIPLE = 2;
+const size_t NOISE_MIN_BYTES = size_t(16) << 20;
+const size_t NOISE_MAX_BYTES = size_t(1) << 30;
+size_t NoiseBufferBytes();
+
+// Starts the noise threads on construction and stops and joins them on destruction.
+class NoiseGenerator {
+   public:
+    explicit NoiseGenerator(const NoiseConfig& config);
+    ~NoiseGenerator();
+    NoiseGenerator(const NoiseGenerator&) = delete;
+    NoiseGenerator& operator=(const NoiseGenerator&) = delete;
+
+    // Units of work done so far, summed over the threads: cache lines for Memory, atomic adds for
+    // Atomic, blocks of arithmetic for Compute. Shows that the noise actually ran.
+    uint64_t Operations() const { return operations.load(std::memory_order_relaxed); }
+
+   private:
+    void Run(uint32_t thread);
+
+    NoiseConfig config;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> operations{0};
+    // Memory noise: one buffer of NoiseBufferBytes(), each thread streaming through its own slice.
+    std::unique_ptr<uint64_t[]> buffer;
+    size_t sliceWords = 0;
+    // Atomic noise: the one line every thread adds to.
+    alignas(64) std::atomic<uint64_t> contended{0};
+    std::vector<std::thread> threads;
+};
@@ -0,0 +1,125 @@
+#include "perfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+namespace {
+
+#ifdef __linux__
+uint64_t CacheEvent(uint64_t cache) {
+    return cache | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+}
+
+int OpenEvent(PerfEvent event, int groupFd) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    // Only the leader's enable bit matters; members follow it.
+    attr.disabled = groupFd < 0;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (event) {
+        case PerfEvent::Cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfEvent::Instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfEvent::CacheMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PerfEvent::L1dReadMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CacheEvent(PERF_COUNT_HW_CACHE_L1D);
+            break;
+        case PerfEvent::BackendStalls:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+            break;
+        default:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CacheEvent(PERF_COUNT_HW_CACHE_NODE);
+            break;
+    }
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+#endif
+
+}  // namespace
+
+PerfCounters::PerfCounters() {
+    for (int& fd : fds) {
+        fd = -1;
+    }
+#ifdef __linux__
+    fds[0] = OpenEvent(PerfEvent::Cycles, -1);
+    for (int i = 1; fds[0] >= 0 && i < static_cast<int>(PerfEvent::Count); ++i) {
+        fds[i] = OpenEvent(static_cast<PerfEvent>(i), fds[0]);
+    }
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    // Members before the leader.
+    for (int i = static_cast<int>(PerfEvent::Count) - 1; i >= 0; --i) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+#endif
+}
+
+void PerfCounters::Start() {
+#ifdef __linux__
+    for (int i = 0; i < static_cast<int>(PerfEvent::Count); ++i) {
+        started[i] = Read(fds[i]);
+    }
+    if (fds[0] >= 0) {
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+}
+
+void PerfCounters::Stop() {
+#ifdef __linux__
+    if (fds[0] >= 0) {
+        ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+    for (int i = 0; i < static_cast<int>(PerfEvent::Count); ++i) {
+        const Sample now = Read(fds[i]);
+        const uint64_t value = now.value - started[i].value;
+        const uint64_t enabled = now.enabled - started[i].enabled;
+        const uint64_t running = now.running - started[i].running;
+        values[i] = 0;
+        if (running) {
+            values[i] = running < enabled ? (uint64_t)((double)value * enabled / running) : value;
+        }
+    }
+#endif
+}
+
+PerfCounters::Sample PerfCounters::Read(int fd) {
+    Sample sample;
+#ifdef __linux__
+    // Read one by one: PERF_FORMAT_GROUP cannot be combined with inherit on older kernels.
+    uint64_t raw[3];
+    if (fd >= 0 && read(fd, raw, sizeof(raw)) == sizeof(raw)) {
+        sample = {raw[0], raw[1], raw[2]};
+    }
+#else
+    (void)fd;
+#endif
+    return sample;
+}
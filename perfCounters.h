@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include "common.h"
+
+// A group of perf_event_open counters covering the calling thread and every thread it spawns while
+// counting (the CPU backend starts its workers inside DispatchKernels). The events are opened as
+// one group led by cycles, so the kernel schedules them onto the PMU together and their ratios
+// describe the same interval even when other counters force multiplexing. An event the CPU or
+// kernel does not expose is left out of the group and reads as zero, with Available(event) false.
+// Where perf events are not available at all (non-Linux hosts, perf_event_paranoid, containers),
+// Available() is false and every counter reads as zero, so callers can report "n/a" instead of
+// failing.
+class PerfCounters {
+   public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool Available() const { return fds[0] >= 0; }
+    bool Available(PerfEvent event) const { return fds[static_cast<int>(event)] >= 0; }
+
+    // Start notes the counts so far and enables the group; Stop disables it and latches what was
+    // counted in between, scaled up by the share of the interval the group was actually on the
+    // PMU. The counts are differences rather than reset, since PERF_EVENT_IOC_RESET clears only
+    // this thread's count and not what exited worker threads have folded into it.
+    void Start();
+    void Stop();
+
+    uint64_t Get(PerfEvent event) const { return values[static_cast<int>(event)]; }
+
+   private:
+    // Value, time enabled and time running, as read from an event's fd.
+    struct Sample {
+        uint64_t value = 0;
+        uint64_t enabled = 0;
+        uint64_t running = 0;
+    };
+
+    // Zeros for a closed or unreadable fd.
+    static Sample Read(int fd);
+
+    int fds[static_cast<int>(PerfEvent::Count)];  // fds[0], cycles, leads the group.
+    Sample started[static_cast<int>(PerfEvent::Count)];
+    uint64_t values[static_cast<int>(PerfEvent::Count)] = {};
+};
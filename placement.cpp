@@ -0,0 +1,265 @@
+#include "placement.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char* const PLACEMENT_NAMES[] = {"none", "compact", "scatter", "socket", "chain"};
+
+// Keeps last-level cache IDs that stand in for a package apart from the CPU numbers that name the
+// real ones.
+const uint32_t PACKAGE_LLC = 0x80000000u;
+
+#ifdef __linux__
+// Parses a sysfs CPU or node list such as "0-3,8,10-11"; empty if the file is missing.
+std::vector<uint32_t> ReadList(const std::string& path) {
+    std::vector<uint32_t> list;
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        return list;
+    }
+    unsigned first;
+    while (fscanf(file, "%u", &first) == 1) {
+        unsigned last = first;
+        int next = fgetc(file);
+        if (next == '-' && fscanf(file, "%u", &last) == 1) {
+            next = fgetc(file);
+        }
+        for (unsigned i = first; i <= last; ++i) {
+            list.push_back(i);
+        }
+        if (next != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return list;
+}
+
+uint32_t ReadUint(const std::string& path, uint32_t fallback) {
+    const std::vector<uint32_t> list = ReadList(path);
+    return list.empty() ? fallback : list[0];
+}
+#endif
+
+// Takes the first of every group, then the second, and so on, skipping exhausted groups.
+std::vector<CpuLocation> Interleave(const std::vector<std::vector<CpuLocation>>& groups) {
+    std::vector<CpuLocation> order;
+    for (size_t i = 0;; ++i) {
+        const size_t before = order.size();
+        for (const auto& group : groups) {
+            if (i < group.size()) {
+                order.push_back(group[i]);
+            }
+        }
+        if (order.size() == before) {
+            return order;
+        }
+    }
+}
+
+// cpus split by key, in increasing key order, each keeping the order of cpus.
+template <class Key>
+std::vector<std::vector<CpuLocation>> GroupBy(const std::vector<CpuLocation>& cpus, Key key) {
+    std::map<uint32_t, std::vector<CpuLocation>> groups;
+    for (const CpuLocation& cpu : cpus) {
+        groups[key(cpu)].push_back(cpu);
+    }
+    std::vector<std::vector<CpuLocation>> out;
+    for (auto& group : groups) {
+        out.push_back(std::move(group.second));
+    }
+    return out;
+}
+
+void SortCompact(std::vector<CpuLocation>& cpus) {
+    std::sort(cpus.begin(), cpus.end(), [](const CpuLocation& a, const CpuLocation& b) {
+        return std::tie(a.package, a.thread, a.llc, a.core, a.cpu) <
+               std::tie(b.package, b.thread, b.llc, b.core, b.cpu);
+    });
+}
+
+void SortChain(std::vector<CpuLocation>& cpus) {
+    std::sort(cpus.begin(), cpus.end(), [](const CpuLocation& a, const CpuLocation& b) {
+        return std::tie(a.package, a.llc, a.core, a.thread, a.cpu) <
+               std::tie(b.package, b.llc, b.core, b.thread, b.cpu);
+    });
+}
+
+}  // namespace
+
+const char* PlacementName(Placement placement) {
+    return PLACEMENT_NAMES[static_cast<int>(placement)];
+}
+
+bool ParsePlacement(const char* name, Placement* out) {
+    for (int i = 0; i < static_cast<int>(Placement::Count); ++i) {
+        if (!strcmp(name, PLACEMENT_NAMES[i])) {
+            *out = static_cast<Placement>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<uint32_t> AllowedCpus() {
+    std::vector<uint32_t> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    if (!sched_getaffinity(0, sizeof(set), &set)) {
+        for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (uint32_t cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<CpuLocation> CpuTopology() {
+    std::vector<CpuLocation> topology;
+#ifdef __linux__
+    std::map<uint32_t, uint32_t> nodeOf;
+    for (uint32_t node : ReadList("/sys/devices/system/node/online")) {
+        const std::string path =
+            "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+        for (uint32_t cpu : ReadList(path)) {
+            nodeOf[cpu] = node;
+        }
+    }
+#endif
+    for (uint32_t cpu : AllowedCpus()) {
+        CpuLocation location = {cpu, 0, 0, PACKAGE_LLC, cpu, 0};
+#ifdef __linux__
+        const std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        location.node = nodeOf.count(cpu) ? nodeOf[cpu] : 0;
+        location.package = ReadUint(base + "/topology/physical_package_id", 0);
+        const std::vector<uint32_t> siblings = ReadList(base + "/topology/thread_siblings_list");
+        if (!siblings.empty()) {
+            location.core = siblings[0];
+            location.thread = static_cast<uint32_t>(
+                std::find(siblings.begin(), siblings.end(), cpu) - siblings.begin());
+        }
+        const std::vector<uint32_t> shared = ReadList(base + "/cache/index3/shared_cpu_list");
+        location.llc = shared.empty() ? PACKAGE_LLC | location.package : shared[0];
+#endif
+        topology.push_back(location);
+    }
+    return topology;
+}
+
+size_t LastLevelCacheBytes() {
+    size_t bytes = 0;
+#ifdef __linux__
+    for (uint32_t cpu : AllowedCpus()) {
+        const std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        const std::vector<uint32_t> shared = ReadList(base + "/cache/index3/shared_cpu_list");
+        if (!shared.empty()) {
+            // Given in KiB, as "32768K".
+            bytes += (size_t(ReadUint(base + "/cache/index3/size", 0)) << 10) / shared.size();
+        }
+    }
+#endif
+    return bytes;
+}
+
+std::vector<CpuLocation> PlaceWorkers(Placement placement, uint32_t workers, uint32_t slot) {
+    return PlaceWorkers(placement, workers, slot, CpuTopology());
+}
+
+std::vector<CpuLocation> PlaceWorkers(Placement placement, uint32_t workers, uint32_t slot,
+                                      std::vector<CpuLocation> cpus) {
+    std::vector<CpuLocation> order;
+    size_t offset = static_cast<size_t>(slot) * workers;
+    switch (placement) {
+        case Placement::Compact:
+            SortCompact(cpus);
+            order = cpus;
+            break;
+        case Placement::Chain:
+            SortChain(cpus);
+            order = cpus;
+            break;
+        case Placement::Scatter: {
+            SortCompact(cpus);
+            std::vector<std::vector<CpuLocation>> packages;
+            for (const auto& package :
+                 GroupBy(cpus, [](const CpuLocation& c) { return c.package; })) {
+                packages.push_back(
+                    Interleave(GroupBy(package, [](const CpuLocation& c) { return c.llc; })));
+            }
+            order = Interleave(packages);
+            break;
+        }
+        case Placement::Socket: {
+            SortCompact(cpus);
+            // Slots take the packages in turn, and the slots that share a package take
+            // successive runs of its CPUs, wrapping only once it runs out.
+            const auto packages = GroupBy(cpus, [](const CpuLocation& c) { return c.package; });
+            order = packages[slot % packages.size()];
+            offset = static_cast<size_t>(slot / packages.size()) * workers;
+            break;
+        }
+        default:
+            return {};
+    }
+    std::vector<CpuLocation> placed;
+    for (uint32_t w = 0; w < workers; ++w) {
+        placed.push_back(order[(offset + w) % order.size()]);
+    }
+    return placed;
+}
+
+bool PinThread(uint32_t cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    // macOS only takes affinity hints, and they group threads rather than name cores.
+    (void)cpu;
+    return false;
+#endif
+}
+
+void BindToNode(void* data, size_t bytes, uint32_t node) {
+#ifdef __linux__
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + page - 1) & ~(page - 1);
+    const uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes) & ~(page - 1);
+    if (end <= begin || node >= 1024) {
+        return;
+    }
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] |= 1ul << node % (8 * sizeof(unsigned long));
+    // Preferred rather than bound, so an exhausted node falls back instead of failing. Failure,
+    // e.g. without CAP_SYS_NICE for pages shared with another process, leaves the pages where
+    // they are.
+    syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED, mask, 8 * sizeof(mask), MPOL_MF_MOVE);
+#else
+    (void)data;
+    (void)bytes;
+    (void)node;
+#endif
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Where the CPU backend runs its emulated workgroups. A lookback step is a load of the line tile
+// n - 1 just stored, so its latency depends on whether the two workers share a core, a last-level
+// cache or a socket. Each policy orders the CPUs this process may run on and pins worker w to the
+// w-th of them, starting after the CPUs of the backends in lower slots, so the concurrent trials of
+// a TrialRunner get disjoint CPUs while there are enough. Tile IDs are bumped in roughly worker
+// order, so consecutive tiles mostly land on consecutive CPUs of the order.
+enum class Placement {
+    None,     // Unpinned; the OS places and migrates the workers.
+    Compact,  // One hardware thread per core, cores in order, a socket filled before the next.
+    Scatter,  // Round-robin across sockets, then last-level caches: neighbours are far apart.
+    Socket,   // All workers of a backend on one socket, slot by slot, with its buffers there.
+    Chain,    // SMT siblings first, then cores sharing a last-level cache, then the next cache.
+    Count,
+};
+
+const char* PlacementName(Placement placement);
+bool ParsePlacement(const char* name, Placement* out);
+
+// One logical CPU and where it sits. On hosts without sysfs topology every CPU is its own core on
+// socket and node 0.
+struct CpuLocation {
+    uint32_t cpu;
+    uint32_t node;     // NUMA node.
+    uint32_t package;  // Socket.
+    uint32_t llc;      // Last-level cache, unique across packages.
+    uint32_t core;     // Physical core, unique across packages.
+    uint32_t thread;   // Index among the core's SMT siblings.
+};
+
+// The CPUs this process may run on, in increasing order.
+std::vector<uint32_t> AllowedCpus();
+
+// The topology of AllowedCpus(). Read afresh on every call, so it reflects an affinity mask set
+// since, such as a shard's.
+std::vector<CpuLocation> CpuTopology();
+
+// The last-level cache this process may use, or 0 where sysfs does not say: each cache counts in
+// proportion to how many of the CPUs sharing it are in AllowedCpus(), so shards pinned to parts of
+// one cache split it rather than each counting all of it.
+size_t LastLevelCacheBytes();
+
+// The CPU of each of workers workers of the backend in slot, under placement; empty for None.
+std::vector<CpuLocation> PlaceWorkers(Placement placement, uint32_t workers, uint32_t slot);
+// The same on a given topology, such as a made-up one in a test.
+std::vector<CpuLocation> PlaceWorkers(Placement placement, uint32_t workers, uint32_t slot,
+                                      std::vector<CpuLocation> cpus);
+
+// Pins the calling thread to one CPU. Returns false where that is not supported.
+bool PinThread(uint32_t cpu);
+
+// Moves the whole pages of [data, data + bytes) to NUMA node, where the kernel supports it.
+void BindToNode(void* data, size_t bytes, uint32_t node);
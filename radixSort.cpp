@@ -0,0 +1,116 @@
+#include "radixSort.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "chainedScan.h"
+
+CpuRadixSort::CpuRadixSort(uint32_t workerCount, WaitPolicy waitPolicy)
+    : workerCount(workerCount ? workerCount : 1), waitPolicy(waitPolicy) {}
+
+void CpuRadixSort::Sort(uint32_t* keys, uint32_t* values, size_t n) {
+    assert(n < MAX_CHAINED_ELEMENTS && "a bin count must fit in a status word");
+    if (n < 2) {
+        return;
+    }
+    const size_t tiles = (n + TILE_KEYS - 1) / TILE_KEYS;
+    if (tiles * RADIX > statusWords) {
+        statusWords = tiles * RADIX;
+        status.reset(new std::atomic<uint32_t>[statusWords]);
+    }
+    altKeys.resize(n);
+    if (values) {
+        altValues.resize(n);
+    }
+
+    Histogram(keys, n);
+
+    // PASSES is even, so after ping-ponging through the alternate buffers the result lands back in
+    // the caller's arrays.
+    uint32_t* src[2] = {keys, values};
+    uint32_t* dst[2] = {altKeys.data(), values ? altValues.data() : nullptr};
+    for (uint32_t pass = 0; pass < PASSES; ++pass) {
+        ChainedPass(src[0], src[1], dst[0], dst[1], n, pass);
+        std::swap(src, dst);
+    }
+}
+
+void CpuRadixSort::Histogram(const uint32_t* keys, size_t n) {
+    std::vector<uint32_t> partial(size_t(workerCount) * PASSES * RADIX, 0);
+    const size_t chunk = (n + workerCount - 1) / workerCount;
+    RunWorkers(workerCount, [&](uint32_t w) {
+        uint32_t* hist = &partial[size_t(w) * PASSES * RADIX];
+        const size_t end = std::min(n, (w + 1) * chunk);
+        for (size_t i = w * chunk; i < end; ++i) {
+            for (uint32_t pass = 0; pass < PASSES; ++pass) {
+                hist[pass * RADIX + (keys[i] >> pass * RADIX_BITS & (RADIX - 1))]++;
+            }
+        }
+    });
+
+    for (uint32_t pass = 0; pass < PASSES; ++pass) {
+        uint32_t sum = 0;
+        for (uint32_t bin = 0; bin < RADIX; ++bin) {
+            globalOffsets[pass][bin] = sum;
+            for (uint32_t w = 0; w < workerCount; ++w) {
+                sum += partial[(size_t(w) * PASSES + pass) * RADIX + bin];
+            }
+        }
+    }
+}
+
+void CpuRadixSort::ChainedPass(const uint32_t* srcKeys, const uint32_t* srcValues,
+                               uint32_t* dstKeys, uint32_t* dstValues, size_t n, uint32_t pass) {
+    const uint32_t tiles = (uint32_t)((n + TILE_KEYS - 1) / TILE_KEYS);
+    tileBump.store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < size_t(tiles) * RADIX; ++i) {
+        status[i].store(FLAG_NOT_READY, std::memory_order_relaxed);
+    }
+
+    // As in the stress kernel, tile IDs come from a bump counter rather than the worker index, so
+    // every predecessor of a tile is already held by a running worker or done.
+    RunWorkers(std::min<uint32_t>(workerCount, tiles), [&](uint32_t) {
+        while (true) {
+            const uint32_t tile = tileBump.fetch_add(1u, std::memory_order_relaxed);
+            if (tile >= tiles) {
+                break;
+            }
+            SortTile(srcKeys, srcValues, dstKeys, dstValues, n, pass, tile);
+        }
+    });
+}
+
+void CpuRadixSort::SortTile(const uint32_t* srcKeys, const uint32_t* srcValues, uint32_t* dstKeys,
+                            uint32_t* dstValues, size_t n, uint32_t pass, uint32_t tile) {
+    const uint32_t shift = pass * RADIX_BITS;
+    const size_t begin = size_t(tile) * TILE_KEYS;
+    const size_t end = std::min(n, begin + TILE_KEYS);
+
+    uint32_t counts[RADIX] = {};
+    for (size_t i = begin; i < end; ++i) {
+        counts[srcKeys[i] >> shift & (RADIX - 1)]++;
+    }
+
+    // Post every bin's count first, so successors can make progress on all bins while this tile
+    // looks back.
+    std::atomic<uint32_t>* self = &status[size_t(tile) * RADIX];
+    for (uint32_t bin = 0; bin < RADIX; ++bin) {
+        PostTileCount(self[bin], tile, counts[bin], waitPolicy, lot);
+    }
+
+    uint32_t offsets[RADIX];
+    for (uint32_t bin = 0; bin < RADIX; ++bin) {
+        offsets[bin] = globalOffsets[pass][bin] +
+                       LookbackTileCount(&status[bin], RADIX, tile, counts[bin], waitPolicy, lot);
+    }
+
+    // Scatter in input order, which keeps the sort stable.
+    for (size_t i = begin; i < end; ++i) {
+        const uint32_t key = srcKeys[i];
+        const uint32_t dst = offsets[key >> shift & (RADIX - 1)]++;
+        dstKeys[dst] = key;
+        if (srcValues) {
+            dstValues[dst] = srcValues[i];
+        }
+    }
+}
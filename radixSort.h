@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "waitPolicy.h"
+
+// LSD radix sort of u32 keys, optionally carrying u32 values, built on the same chained lookback
+// as the stress kernel. Keys are sorted 8 bits at a time: one upfront pass builds the histogram of
+// every digit, then each digit gets one chained pass (Onesweep, Adinets and Merrill 2022). In a
+// chained pass every tile counts its keys per bin, posts the counts READY, looks back bin by bin
+// until it meets an INCLUSIVE predecessor, posts its own INCLUSIVE counts and scatters its keys
+// straight to their final position. The sort is stable.
+class CpuRadixSort {
+   public:
+    explicit CpuRadixSort(uint32_t workerCount, WaitPolicy waitPolicy = WaitPolicy::Pause);
+
+    // Sorts keys[0, n) in place; values, if non-null, are permuted alongside. n must be below 2^30
+    // so a bin count fits beside the flags in one status word.
+    void Sort(uint32_t* keys, uint32_t* values, size_t n);
+
+    static const uint32_t RADIX_BITS = 8;
+    static const uint32_t RADIX = 1u << RADIX_BITS;
+    static const uint32_t PASSES = 32 / RADIX_BITS;
+    static const uint32_t TILE_KEYS = 8192;
+
+   private:
+    void Histogram(const uint32_t* keys, size_t n);
+    void ChainedPass(const uint32_t* srcKeys, const uint32_t* srcValues, uint32_t* dstKeys,
+                     uint32_t* dstValues, size_t n, uint32_t pass);
+    void SortTile(const uint32_t* srcKeys, const uint32_t* srcValues, uint32_t* dstKeys,
+                  uint32_t* dstValues, size_t n, uint32_t pass, uint32_t tile);
+
+    uint32_t workerCount;
+    WaitPolicy waitPolicy;
+    ParkingLot lot;
+    // Exclusive prefix of each digit's global histogram: where bin b of pass p starts.
+    uint32_t globalOffsets[PASSES][RADIX];
+    // Per pass: scan_bump and the status buffer, status[tile][bin] = count | FLAG.
+    std::atomic<uint32_t> tileBump{0};
+    std::unique_ptr<std::atomic<uint32_t>[]> status;
+    size_t statusWords = 0;
+    std::vector<uint32_t> altKeys;
+    std::vector<uint32_t> altValues;
+};
@@ -0,0 +1,79 @@
+#include <metal_stdlib>
+using namespace metal;
+
+// The reduce-then-scan baseline for the stress kernel: the same scan, as three dispatches with no
+// inter-workgroup communication. It leaves the scan buffer exactly as a successful stress run does,
+// every tile posting its split inclusive prefix with FLAG_INCLUSIVE, so the host validates both the
+// same way. Only the single-scan configuration is supported; there is no TILES_PER_SCAN here.
+
+// Must exactly match the host code.
+constant uint SPLIT_THREADS = 2;
+constant uint FLAG_INCLUSIVE = 0x80000000;
+constant uint VALUE_MASK = 0xffff;
+constant uint BLOCK_DIM = 32;
+constant uint TEST_SIZE = 65535;
+
+// The scan of the reductions runs as one threadgroup of SCAN_THREADS, each of which scans a
+// contiguous run of TILES_PER_THREAD tiles serially.
+constant uint SCAN_THREADS = 1024;
+constant uint TILES_PER_THREAD = (TEST_SIZE + SCAN_THREADS - 1) / SCAN_THREADS;
+
+uint split(uint x, uint tid) { return x >> tid * 16 & VALUE_MASK; }
+
+// Reduces each tile and leaves the reduction in the lane 0 entry of its scan buffer slot. Every
+// thread of the stress kernel contributes BLOCK_DIM, so a tile reduces to BLOCK_DIM * BLOCK_DIM.
+kernel void reduce(uint3 threadid [[thread_position_in_threadgroup]],
+                   uint3 tileid [[threadgroup_position_in_grid]],
+                   device uint* scan [[buffer(1)]]) {
+    const uint reduction = simd_sum(BLOCK_DIM);
+    if (threadid.x == 0) {
+        scan[tileid.x * SPLIT_THREADS] = reduction;
+    }
+}
+
+// Exclusive scan of the tile reductions, in place.
+kernel void scanReductions(uint3 threadid [[thread_position_in_threadgroup]],
+                           uint simd_lane [[thread_index_in_simdgroup]],
+                           uint simd_id [[simdgroup_index_in_threadgroup]],
+                           device uint* scan [[buffer(1)]]) {
+    threadgroup uint simdTotals[SCAN_THREADS / BLOCK_DIM];
+    const uint begin = threadid.x * TILES_PER_THREAD;
+    const uint end = min(begin + TILES_PER_THREAD, TEST_SIZE);
+
+    uint sum = 0;
+    for (uint t = begin; t < end; ++t) {
+        sum += scan[t * SPLIT_THREADS];
+    }
+
+    // Threadgroup-wide exclusive scan of the per-thread sums: within each simdgroup, then across
+    // the simdgroup totals.
+    uint prefix = simd_prefix_exclusive_sum(sum);
+    if (simd_lane == BLOCK_DIM - 1) {
+        simdTotals[simd_id] = prefix + sum;
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    if (simd_id == 0) {
+        simdTotals[simd_lane] = simd_prefix_exclusive_sum(simdTotals[simd_lane]);
+    }
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+    prefix += simdTotals[simd_id];
+
+    for (uint t = begin; t < end; ++t) {
+        const uint reduction = scan[t * SPLIT_THREADS];
+        scan[t * SPLIT_THREADS] = prefix;
+        prefix += reduction;
+    }
+}
+
+// Adds each tile's own reduction back to its exclusive prefix and posts the result the way the
+// stress kernel does.
+kernel void downsweep(uint3 threadid [[thread_position_in_threadgroup]],
+                      uint3 tileid [[threadgroup_position_in_grid]],
+                      device uint* scan [[buffer(1)]]) {
+    const uint inclusive = scan[tileid.x * SPLIT_THREADS] + simd_sum(BLOCK_DIM);
+    // Both split threads must read lane 0's entry before either overwrites it.
+    simdgroup_barrier(mem_flags::mem_device);
+    if (threadid.x < SPLIT_THREADS) {
+        scan[tileid.x * SPLIT_THREADS + threadid.x] = split(inclusive, threadid.x) | FLAG_INCLUSIVE;
+    }
+}
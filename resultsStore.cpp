@@ -0,0 +1,340 @@
+#include "resultsStore.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const char STORE_MAGIC[8] = {'M', 'M', 'R', 'S', 'T', 'O', 'R', 'E'};
+// Version 2 widened the configuration names to CONFIG_NAME_BYTES = 512.
+const uint32_t STORE_VERSION = 2;
+// Room for the header, a multiple of the 16 KiB page so that chunks can be mapped on any host.
+// Every column is a multiple of 4 bytes per row, so CHUNK_ROWS rows of it are a multiple of 16 KiB
+// too.
+const size_t HEADER_BYTES = 65536;
+
+}  // namespace
+
+struct StoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t columnCount;
+    uint32_t chunkRows;
+    uint32_t configCount;
+    // Rows fully written. Bumped after each row, so an interrupted run loses at most the row in
+    // flight.
+    uint64_t rowCount;
+    ColumnInfo columns[MAX_COLUMNS];
+    char configs[MAX_CONFIGS][CONFIG_NAME_BYTES];
+};
+
+static_assert(sizeof(StoreHeader) <= HEADER_BYTES, "the header must fit in HEADER_BYTES");
+
+namespace {
+
+// A column of this build's schema and where it lives in a TrialRecord.
+struct ColumnDef {
+    ColumnInfo info;
+    size_t offset;
+};
+
+ColumnDef Def(const char* name, ColumnType type, size_t offset) {
+    ColumnDef def = {};
+    snprintf(def.info.name, sizeof(def.info.name), "%s", name);
+    def.info.type = type;
+    def.info.bytes = type == ColumnType::U64 ? 8 : 4;
+    def.offset = offset;
+    return def;
+}
+
+const std::vector<ColumnDef>& Schema() {
+    static const std::vector<ColumnDef> schema = [] {
+        std::vector<ColumnDef> s = {
+            Def("start_ns", ColumnType::U64, offsetof(TrialRecord, startNs)),
+            Def("seed", ColumnType::U64, offsetof(TrialRecord, seed)),
+            Def("trial", ColumnType::U32, offsetof(TrialRecord, trial)),
+            Def("config", ColumnType::U32, offsetof(TrialRecord, configId)),
+            Def("dispatch_ms", ColumnType::F32, offsetof(TrialRecord, dispatchMs)),
+            Def("validate_ms", ColumnType::F32, offsetof(TrialRecord, validateMs)),
+            Def("failed", ColumnType::U32, offsetof(TrialRecord, failed)),
+        };
+        char name[sizeof(ColumnInfo::name)];
+        for (uint32_t k = 0; k < static_cast<uint32_t>(FailureKind::Count); ++k) {
+            snprintf(name, sizeof(name), "fail_%s", FailureKindName(static_cast<FailureKind>(k)));
+            s.push_back(Def(name, ColumnType::U32,
+                            offsetof(TrialRecord, failures) + k * sizeof(uint32_t)));
+        }
+        for (uint32_t b = 0; b < SPIN_BUCKETS; ++b) {
+            snprintf(name, sizeof(name), "spin_%u", b);
+            s.push_back(
+                Def(name, ColumnType::U32, offsetof(TrialRecord, spins) + b * sizeof(uint32_t)));
+        }
+        for (uint32_t e = 0; e < static_cast<uint32_t>(PerfEvent::Count); ++e) {
+            snprintf(name, sizeof(name), "perf_%s", PerfEventName(static_cast<PerfEvent>(e)));
+            s.push_back(Def(name, ColumnType::U64,
+                            offsetof(TrialRecord, counters) + e * sizeof(uint64_t)));
+        }
+        return s;
+    }();
+    return schema;
+}
+
+// Byte offset of every column within a chunk, and the chunk size, for a file's schema.
+size_t ChunkLayout(const ColumnInfo* columns, uint32_t columnCount, uint32_t chunkRows,
+                   size_t* offsets) {
+    size_t offset = 0;
+    for (uint32_t c = 0; c < columnCount; ++c) {
+        offsets[c] = offset;
+        offset += (size_t)columns[c].bytes * chunkRows;
+    }
+    return offset;
+}
+
+size_t SchemaChunkBytes() {
+    size_t rowBytes = 0;
+    for (const ColumnDef& def : Schema()) {
+        rowBytes += def.info.bytes;
+    }
+    return rowBytes * CHUNK_ROWS;
+}
+
+}  // namespace
+
+void CountFailures(const FailureList& list, TrialRecord& record) {
+    for (const FailureRecord& r : list.records) {
+        record.failures[static_cast<uint32_t>(r.kind)]++;
+    }
+    // Dropped records were scan mismatches past the cap: only the scan validator can overflow it.
+    record.failures[static_cast<uint32_t>(FailureKind::Scan)] += list.dropped;
+}
+
+std::string HostName() {
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1)) {
+        return "unknown";
+    }
+    return name;
+}
+
+ResultsWriter::~ResultsWriter() {
+    if (chunk) {
+        munmap(chunk, SchemaChunkBytes());
+    }
+    if (header) {
+        munmap(header, HEADER_BYTES);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool ResultsWriter::Open(const char* path) {
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        printf("Failed to open results store %s.\n", path);
+        return false;
+    }
+    const bool fresh = st.st_size == 0;
+    if ((fresh && ftruncate(fd, HEADER_BYTES)) || (!fresh && (size_t)st.st_size < HEADER_BYTES)) {
+        printf("Results store %s is truncated.\n", path);
+        return false;
+    }
+    void* mapped = mmap(nullptr, HEADER_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        printf("Failed to map results store %s.\n", path);
+        return false;
+    }
+    header = static_cast<StoreHeader*>(mapped);
+
+    const std::vector<ColumnDef>& schema = Schema();
+    if (fresh) {
+        memcpy(header->magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+        header->version = STORE_VERSION;
+        header->columnCount = static_cast<uint32_t>(schema.size());
+        header->chunkRows = CHUNK_ROWS;
+        for (size_t c = 0; c < schema.size(); ++c) {
+            header->columns[c] = schema[c].info;
+        }
+        return true;
+    }
+
+    // Appending writes rows in this build's layout, so the file must already use it.
+    bool same = !memcmp(header->magic, STORE_MAGIC, sizeof(STORE_MAGIC)) &&
+                header->version == STORE_VERSION && header->chunkRows == CHUNK_ROWS &&
+                header->columnCount == schema.size();
+    for (size_t c = 0; same && c < schema.size(); ++c) {
+        same = !strcmp(header->columns[c].name, schema[c].info.name) &&
+               header->columns[c].type == schema[c].info.type;
+    }
+    if (!same) {
+        printf("Results store %s has a different schema; write to a new file and merge.\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool ResultsWriter::ConfigId(const std::string& name, uint32_t* id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (uint32_t c = 0; c < header->configCount; ++c) {
+        if (!strncmp(header->configs[c], name.c_str(), CONFIG_NAME_BYTES - 1)) {
+            *id = c;
+            return true;
+        }
+    }
+    if (header->configCount == MAX_CONFIGS) {
+        printf("Results store configuration table is full (%u entries).\n", MAX_CONFIGS);
+        return false;
+    }
+    snprintf(header->configs[header->configCount], CONFIG_NAME_BYTES, "%s", name.c_str());
+    *id = header->configCount++;
+    return true;
+}
+
+bool ResultsWriter::MapChunk(uint64_t index) {
+    const size_t chunkBytes = SchemaChunkBytes();
+    if (chunk) {
+        munmap(chunk, chunkBytes);
+        chunk = nullptr;
+    }
+    const off_t offset = HEADER_BYTES + (off_t)index * chunkBytes;
+    struct stat st;
+    if (fstat(fd, &st) || (st.st_size < offset + (off_t)chunkBytes &&
+                           ftruncate(fd, offset + (off_t)chunkBytes))) {
+        return false;
+    }
+    void* mapped = mmap(nullptr, chunkBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    chunk = static_cast<uint8_t*>(mapped);
+    mappedChunk = index;
+    return true;
+}
+
+void ResultsWriter::Append(const TrialRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint64_t row = header->rowCount;
+    if (row / CHUNK_ROWS != mappedChunk && !MapChunk(row / CHUNK_ROWS)) {
+        printf("Failed to grow the results store; trial %u is not recorded.\n", record.trial);
+        return;
+    }
+    const uint32_t r = row % CHUNK_ROWS;
+    size_t offset = 0;
+    for (const ColumnDef& def : Schema()) {
+        memcpy(chunk + offset + (size_t)r * def.info.bytes,
+               reinterpret_cast<const uint8_t*>(&record) + def.offset, def.info.bytes);
+        offset += (size_t)def.info.bytes * CHUNK_ROWS;
+    }
+    header->rowCount = row + 1;
+}
+
+uint64_t ResultsWriter::Rows() const { return header ? header->rowCount : 0; }
+
+ResultsReader::~ResultsReader() {
+    if (base) {
+        munmap(const_cast<uint8_t*>(base), length);
+    }
+}
+
+bool ResultsReader::Open(const char* path) {
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) || (size_t)st.st_size < HEADER_BYTES) {
+        printf("%s is not a results store.\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    length = st.st_size;
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        printf("Failed to map %s.\n", path);
+        return false;
+    }
+    base = static_cast<const uint8_t*>(mapped);
+    header = reinterpret_cast<const StoreHeader*>(base);
+    if (memcmp(header->magic, STORE_MAGIC, sizeof(STORE_MAGIC)) ||
+        header->version != STORE_VERSION || header->columnCount > MAX_COLUMNS ||
+        header->configCount > MAX_CONFIGS || !header->chunkRows) {
+        printf("%s is not a results store of version %u.\n", path, STORE_VERSION);
+        return false;
+    }
+
+    const std::vector<ColumnDef>& schema = Schema();
+    for (size_t c = 0; c < schema.size(); ++c) {
+        const int found = FindColumn(schema[c].info.name);
+        columnOf[c] = found >= 0 && header->columns[found].type == schema[c].info.type ? found : -1;
+    }
+    return true;
+}
+
+uint64_t ResultsReader::Rows() const {
+    // A run interrupted while growing the file can leave the count ahead of the mapped chunks.
+    size_t offsets[MAX_COLUMNS];
+    const size_t chunkBytes =
+        ChunkLayout(header->columns, header->columnCount, header->chunkRows, offsets);
+    const uint64_t fullChunks = chunkBytes ? (length - HEADER_BYTES) / chunkBytes : 0;
+    return std::min<uint64_t>(header->rowCount, fullChunks * header->chunkRows);
+}
+
+uint32_t ResultsReader::Chunks() const {
+    return static_cast<uint32_t>((Rows() + header->chunkRows - 1) / header->chunkRows);
+}
+
+uint32_t ResultsReader::ChunkRows(uint32_t chunk) const {
+    const uint64_t remaining = Rows() - (uint64_t)chunk * header->chunkRows;
+    return static_cast<uint32_t>(std::min<uint64_t>(remaining, header->chunkRows));
+}
+
+uint32_t ResultsReader::ConfigCount() const { return header->configCount; }
+
+const char* ResultsReader::ConfigName(uint32_t id) const {
+    return id < header->configCount ? header->configs[id] : "?";
+}
+
+uint32_t ResultsReader::ColumnCount() const { return header->columnCount; }
+
+const ColumnInfo& ResultsReader::ColumnSchema(uint32_t column) const {
+    return header->columns[column];
+}
+
+int ResultsReader::FindColumn(const char* name) const {
+    for (uint32_t c = 0; c < header->columnCount; ++c) {
+        if (!strncmp(header->columns[c].name, name, sizeof(ColumnInfo::name))) {
+            return static_cast<int>(c);
+        }
+    }
+    return -1;
+}
+
+const void* ResultsReader::Column(uint32_t chunk, uint32_t column) const {
+    size_t offsets[MAX_COLUMNS];
+    const size_t chunkBytes =
+        ChunkLayout(header->columns, header->columnCount, header->chunkRows, offsets);
+    return base + HEADER_BYTES + (size_t)chunk * chunkBytes + offsets[column];
+}
+
+TrialRecord ResultsReader::Row(uint32_t chunk, uint32_t row) const {
+    TrialRecord record;
+    const std::vector<ColumnDef>& schema = Schema();
+    for (size_t c = 0; c < schema.size(); ++c) {
+        if (columnOf[c] < 0) {
+            continue;
+        }
+        const uint32_t bytes = schema[c].info.bytes;
+        const uint8_t* column = static_cast<const uint8_t*>(Column(chunk, columnOf[c]));
+        memcpy(reinterpret_cast<uint8_t*>(&record) + schema[c].offset, column + (size_t)row * bytes,
+               bytes);
+    }
+    return record;
+}
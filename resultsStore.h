@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "common.h"
+#include "failureLog.h"
+
+// A compact binary, columnar record of every trial of a run, written through mmap so that soak runs
+// of thousands of trials cost no console output and survive being interrupted. The file is a fixed
+// header followed by chunks of CHUNK_ROWS rows; within a chunk each column is one contiguous array,
+// so an aggregate over a column touches only that column's pages. The header carries the column
+// schema and a table of configuration names (which include the host), so files from different runs
+// and machines merge by appending rows and remapping configuration IDs. See resultsTool.cpp.
+
+// One trial's summary: a row of the store.
+struct TrialRecord {
+    uint64_t startNs = 0;   // Wall clock at the start of the trial, ns since the Unix epoch.
+    uint64_t seed = 0;      // Seed of the trial's scheduler randomness; 0 if it has none.
+    uint32_t trial = 0;     // 1-based index within its run.
+    uint32_t configId = 0;  // Index into the store's configuration table.
+    float dispatchMs = 0;
+    float validateMs = 0;
+    uint32_t failed = 0;  // FAILED_SCAN | FAILED_ERRORS.
+    uint32_t failures[static_cast<uint32_t>(FailureKind::Count)] = {};  // Records per kind.
+    uint32_t spins[SPIN_BUCKETS] = {};  // Tiles per SpinBucket of lookback polls.
+    // Hardware events over the trial's stress phase, when the run captured them; else zero.
+    uint64_t counters[static_cast<uint32_t>(PerfEvent::Count)] = {};
+};
+
+const uint32_t FAILED_SCAN = 1u;
+const uint32_t FAILED_ERRORS = 2u;
+
+// Counts the records of list per kind into record.failures.
+void CountFailures(const FailureList& list, TrialRecord& record);
+
+enum class ColumnType : uint32_t {
+    U32,
+    U64,
+    F32,
+};
+
+struct ColumnInfo {
+    char name[24];
+    ColumnType type;
+    uint32_t bytes;  // Per row.
+};
+
+// Layout of the file; see resultsStore.cpp.
+struct StoreHeader;
+
+const uint32_t CHUNK_ROWS = 4096;
+const uint32_t MAX_COLUMNS = 64;
+const uint32_t MAX_CONFIGS = 64;
+// Room for the host name and every setting of the run, so the store alone says how to rerun it.
+const uint32_t CONFIG_NAME_BYTES = 512;
+
+// Name of this machine, for configuration names.
+std::string HostName();
+
+// Appends TrialRecords to a store, creating it if it does not exist. Append is thread-safe.
+class ResultsWriter {
+   public:
+    ResultsWriter() = default;
+    ~ResultsWriter();
+    ResultsWriter(const ResultsWriter&) = delete;
+    ResultsWriter& operator=(const ResultsWriter&) = delete;
+
+    // Opens path for appending. An existing file must have this build's schema. Prints the reason
+    // and returns false on failure.
+    bool Open(const char* path);
+
+    // The ID of a configuration name, added to the table if new. Returns false when the table is
+    // full.
+    bool ConfigId(const std::string& name, uint32_t* id);
+
+    void Append(const TrialRecord& record);
+
+    uint64_t Rows() const;
+
+   private:
+    bool MapChunk(uint64_t chunk);
+
+    std::mutex mutex;
+    int fd = -1;
+    StoreHeader* header = nullptr;
+    uint8_t* chunk = nullptr;
+    uint64_t mappedChunk = UINT64_MAX;
+};
+
+// Read-only view of a store. Nothing is read until a column is touched, and then only its pages.
+class ResultsReader {
+   public:
+    ResultsReader() = default;
+    ~ResultsReader();
+    ResultsReader(const ResultsReader&) = delete;
+    ResultsReader& operator=(const ResultsReader&) = delete;
+
+    // Prints the reason and returns false if path is not a readable store.
+    bool Open(const char* path);
+
+    uint64_t Rows() const;
+    uint32_t Chunks() const;
+    // Rows stored in a chunk: CHUNK_ROWS except in the last.
+    uint32_t ChunkRows(uint32_t chunk) const;
+    uint32_t ConfigCount() const;
+    const char* ConfigName(uint32_t id) const;
+
+    uint32_t ColumnCount() const;
+    const ColumnInfo& ColumnSchema(uint32_t column) const;
+    // Index of a column by name in this file's schema, or -1.
+    int FindColumn(const char* name) const;
+    // The first row of a column within a chunk; rows are ColumnInfo::bytes apart.
+    const void* Column(uint32_t chunk, uint32_t column) const;
+
+    // Gathers one row into a TrialRecord. Columns the file does not have read as zero.
+    TrialRecord Row(uint32_t chunk, uint32_t row) const;
+
+   private:
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+    const StoreHeader* header = nullptr;
+    int columnOf[MAX_COLUMNS];  // This build's column c is the file's column columnOf[c], or -1.
+};
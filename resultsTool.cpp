@@ -0,0 +1,382 @@
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "resultsStore.h"
+
+// Reads results stores written by cpuMinRepro and metalMinRepro. summary aggregates any number of
+// stores by configuration name, merge appends stores into one, and csv dumps a store as text.
+
+namespace {
+
+const uint32_t PERF_EVENTS = static_cast<uint32_t>(PerfEvent::Count);
+
+// One trial's hardware counters next to its latency.
+struct CountedTrial {
+    float dispatchMs;
+    std::array<uint64_t, PERF_EVENTS> counters;
+};
+
+// Orders a heap with the fastest trial on top.
+bool Slower(const CountedTrial& a, const CountedTrial& b) { return a.dispatchMs > b.dispatchMs; }
+
+// Dispatch latencies are counted in buckets 1/LATENCY_SUBBUCKETS of an octave wide from
+// LATENCY_MIN_MS up, so a configuration's quantiles take the same 20 KiB however many trials it
+// has. A quantile is read as the geometric middle of its bucket, within 0.6% of the exact value.
+const double LATENCY_MIN_MS = 1e-4;
+const uint32_t LATENCY_SUBBUCKETS = 64;
+const uint32_t LATENCY_BUCKETS = 40 * LATENCY_SUBBUCKETS;  // Up to about 30 hours.
+
+struct LatencyHistogram {
+    uint64_t buckets[LATENCY_BUCKETS] = {};
+    uint64_t count = 0;
+    double sum = 0;
+    float minMs = INFINITY;
+    float maxMs = 0;
+
+    void Add(float ms) {
+        const double octaves = ms > LATENCY_MIN_MS ? std::log2(ms / LATENCY_MIN_MS) : 0;
+        buckets[std::min<uint32_t>(LATENCY_BUCKETS - 1,
+                                   (uint32_t)(octaves * LATENCY_SUBBUCKETS))]++;
+        count++;
+        sum += ms;
+        minMs = std::min(minMs, ms);
+        maxMs = std::max(maxMs, ms);
+    }
+
+    // The q-quantile, clamped to the exact extremes. Requires count > 0.
+    float Quantile(double q) const {
+        const uint64_t rank = std::min<uint64_t>(count - 1, (uint64_t)(q * count));
+        uint64_t below = 0;
+        uint32_t b = 0;
+        while (below + buckets[b] <= rank) {
+            below += buckets[b++];
+        }
+        const float ms = (float)(LATENCY_MIN_MS *
+                                 std::exp2((b + 0.5) / LATENCY_SUBBUCKETS));
+        return std::min(maxMs, std::max(minMs, ms));
+    }
+};
+
+// Everything summary keeps per configuration.
+struct ConfigTotals {
+    uint64_t trials = 0;
+    uint64_t failedTrials = 0;
+    uint64_t failures[static_cast<uint32_t>(FailureKind::Count)] = {};
+    uint64_t spins[SPIN_BUCKETS] = {};
+    LatencyHistogram dispatch;
+    double validateMs = 0;
+    // The trials recorded with --perf. They are counted in a first pass over the stores so that
+    // the second can keep the slowest 1% in a heap of fixed size.
+    uint64_t counted = 0;
+    double counterSums[PERF_EVENTS] = {};
+    std::vector<CountedTrial> slowest;  // Heap ordered by Slower, at most max(1, counted / 100).
+};
+
+// A column of the reader's current chunk as a typed pointer, or nullptr if the file lacks it.
+template <class T>
+const T* ColumnOf(const ResultsReader& reader, uint32_t chunk, const char* name) {
+    const int column = reader.FindColumn(name);
+    return column < 0 ? nullptr : static_cast<const T*>(reader.Column(chunk, column));
+}
+
+// Every trial of a run with counters counts cycles.
+bool IsCounted(const uint64_t* cycles, uint32_t row) { return cycles && cycles[row]; }
+
+// Maps a store's configuration IDs to their totals.
+std::vector<ConfigTotals*> TotalsById(const ResultsReader& reader,
+                                      std::map<std::string, ConfigTotals>& totals) {
+    std::vector<ConfigTotals*> byId(reader.ConfigCount());
+    for (uint32_t id = 0; id < reader.ConfigCount(); ++id) {
+        byId[id] = &totals[reader.ConfigName(id)];
+    }
+    return byId;
+}
+
+// The first pass: counts the trials of one store recorded with counters.
+void CountCounted(const ResultsReader& reader, std::map<std::string, ConfigTotals>& totals) {
+    const std::vector<ConfigTotals*> byId = TotalsById(reader, totals);
+    char name[sizeof(ColumnInfo::name)];
+    snprintf(name, sizeof(name), "perf_%s", PerfEventName(PerfEvent::Cycles));
+    for (uint32_t chunk = 0; chunk < reader.Chunks(); ++chunk) {
+        const uint32_t* config = ColumnOf<uint32_t>(reader, chunk, "config");
+        const uint64_t* cycles = ColumnOf<uint64_t>(reader, chunk, name);
+        for (uint32_t r = 0; cycles && r < reader.ChunkRows(chunk); ++r) {
+            const uint32_t id = config ? config[r] : 0;
+            if (id < byId.size() && IsCounted(cycles, r)) {
+                byId[id]->counted++;
+            }
+        }
+    }
+}
+
+// Folds one store into totals, reading only the columns summary prints.
+void Accumulate(const ResultsReader& reader, std::map<std::string, ConfigTotals>& totals) {
+    const std::vector<ConfigTotals*> byId = TotalsById(reader, totals);
+    char name[sizeof(ColumnInfo::name)];
+    for (uint32_t chunk = 0; chunk < reader.Chunks(); ++chunk) {
+        const uint32_t rows = reader.ChunkRows(chunk);
+        const uint32_t* config = ColumnOf<uint32_t>(reader, chunk, "config");
+        const uint32_t* failed = ColumnOf<uint32_t>(reader, chunk, "failed");
+        const float* dispatch = ColumnOf<float>(reader, chunk, "dispatch_ms");
+        const float* validate = ColumnOf<float>(reader, chunk, "validate_ms");
+        const uint32_t* failures[static_cast<uint32_t>(FailureKind::Count)];
+        for (uint32_t k = 0; k < static_cast<uint32_t>(FailureKind::Count); ++k) {
+            snprintf(name, sizeof(name), "fail_%s", FailureKindName(static_cast<FailureKind>(k)));
+            failures[k] = ColumnOf<uint32_t>(reader, chunk, name);
+        }
+        const uint32_t* spins[SPIN_BUCKETS];
+        for (uint32_t b = 0; b < SPIN_BUCKETS; ++b) {
+            snprintf(name, sizeof(name), "spin_%u", b);
+            spins[b] = ColumnOf<uint32_t>(reader, chunk, name);
+        }
+        const uint64_t* counters[PERF_EVENTS];
+        for (uint32_t e = 0; e < PERF_EVENTS; ++e) {
+            snprintf(name, sizeof(name), "perf_%s", PerfEventName(static_cast<PerfEvent>(e)));
+            counters[e] = ColumnOf<uint64_t>(reader, chunk, name);
+        }
+        const uint64_t* cycles = counters[static_cast<uint32_t>(PerfEvent::Cycles)];
+
+        for (uint32_t r = 0; r < rows; ++r) {
+            const uint32_t id = config ? config[r] : 0;
+            if (id >= byId.size()) {
+                continue;
+            }
+            ConfigTotals& t = *byId[id];
+            t.trials++;
+            t.failedTrials += failed && failed[r];
+            if (dispatch) {
+                t.dispatch.Add(dispatch[r]);
+            }
+            t.validateMs += validate ? validate[r] : 0;
+            for (uint32_t k = 0; k < static_cast<uint32_t>(FailureKind::Count); ++k) {
+                t.failures[k] += failures[k] ? failures[k][r] : 0;
+            }
+            for (uint32_t b = 0; b < SPIN_BUCKETS; ++b) {
+                t.spins[b] += spins[b] ? spins[b][r] : 0;
+            }
+            if (IsCounted(cycles, r)) {
+                CountedTrial trial = {dispatch ? dispatch[r] : 0, {}};
+                for (uint32_t e = 0; e < PERF_EVENTS; ++e) {
+                    trial.counters[e] = counters[e] ? counters[e][r] : 0;
+                    t.counterSums[e] += trial.counters[e];
+                }
+                const size_t keep = std::max<uint64_t>(1, t.counted / 100);
+                if (t.slowest.size() < keep || Slower(trial, t.slowest.front())) {
+                    t.slowest.push_back(trial);
+                    std::push_heap(t.slowest.begin(), t.slowest.end(), Slower);
+                    if (t.slowest.size() > keep) {
+                        std::pop_heap(t.slowest.begin(), t.slowest.end(), Slower);
+                        t.slowest.pop_back();
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Mean counters of every counted trial next to those of the slowest 1%, so a latency tail can be
+// told apart as misses, stalls or plain spinning; and per tile when the lookback polls say how
+// many tiles a trial ran.
+void PrintCounters(const ConfigTotals& t, double tilesPerTrial) {
+    double all[PERF_EVENTS] = {};
+    double tail[PERF_EVENTS] = {};
+    for (const CountedTrial& trial : t.slowest) {
+        for (uint32_t e = 0; e < PERF_EVENTS; ++e) {
+            tail[e] += trial.counters[e];
+        }
+    }
+    printf("  counters over the scan passes, mean of %" PRIu64 " trials:\n", t.counted);
+    printf("    %-16s %14s %14s %10s\n", "", "all", "slowest 1%", "per tile");
+    for (uint32_t e = 0; e < PERF_EVENTS; ++e) {
+        all[e] = t.counterSums[e] / t.counted;
+        tail[e] /= t.slowest.size();
+        printf("    %-16s %14.0f %14.0f", PerfEventName(static_cast<PerfEvent>(e)), all[e],
+               tail[e]);
+        if (tilesPerTrial > 0) {
+            printf(" %10.2f", all[e] / tilesPerTrial);
+        }
+        printf("\n");
+    }
+    const uint32_t cycles = static_cast<uint32_t>(PerfEvent::Cycles);
+    const uint32_t instructions = static_cast<uint32_t>(PerfEvent::Instructions);
+    printf("    %-16s %14.2f %14.2f\n", "ipc", all[instructions] / all[cycles],
+           tail[instructions] / tail[cycles]);
+}
+
+int Summary(int count, const char* const* paths) {
+    std::vector<std::unique_ptr<ResultsReader>> readers;
+    for (int i = 0; i < count; ++i) {
+        readers.emplace_back(new ResultsReader);
+        if (!readers.back()->Open(paths[i])) {
+            return 1;
+        }
+    }
+    std::map<std::string, ConfigTotals> totals;
+    for (const auto& reader : readers) {
+        CountCounted(*reader, totals);
+    }
+    for (const auto& reader : readers) {
+        Accumulate(*reader, totals);
+    }
+
+    for (auto& entry : totals) {
+        ConfigTotals& t = entry.second;
+        if (!t.trials) {
+            continue;
+        }
+        printf("%s\n", entry.first.c_str());
+        printf("  trials %" PRIu64 ", failed %" PRIu64 " (%.4f%%)\n", t.trials, t.failedTrials,
+               100.0 * t.failedTrials / t.trials);
+        for (uint32_t k = 0; k < static_cast<uint32_t>(FailureKind::Count); ++k) {
+            if (t.failures[k]) {
+                printf("  %-13s %" PRIu64 " records\n",
+                       FailureKindName(static_cast<FailureKind>(k)), t.failures[k]);
+            }
+        }
+        if (t.dispatch.count) {
+            printf("  dispatch ms: mean %.3f, min %.3f, p50 %.3f, p99 %.3f, max %.3f\n",
+                   t.dispatch.sum / t.dispatch.count, t.dispatch.minMs, t.dispatch.Quantile(0.5),
+                   t.dispatch.Quantile(0.99), t.dispatch.maxMs);
+        }
+        printf("  validate ms: mean %.3f\n", t.validateMs / t.trials);
+
+        uint64_t tiles = 0;
+        for (uint32_t b = 0; b < SPIN_BUCKETS; ++b) {
+            tiles += t.spins[b];
+        }
+        if (tiles) {
+            printf("  lookback polls per tile (%% of %" PRIu64 " tiles):", tiles);
+            for (uint32_t b = 0; b < SPIN_BUCKETS; ++b) {
+                if (t.spins[b]) {
+                    printf(" %s%u:%.2f", b + 1 == SPIN_BUCKETS ? ">=" : "",
+                           b ? 1u << (b - 1) : 0u, 100.0 * t.spins[b] / tiles);
+                }
+            }
+            printf("\n");
+        }
+        if (t.counted) {
+            PrintCounters(t, (double)tiles / t.trials);
+        }
+    }
+    return 0;
+}
+
+// Whether two paths name the same existing file.
+bool SameFile(const char* a, const char* b) {
+    struct stat sa, sb;
+    return stat(a, &sa) == 0 && stat(b, &sb) == 0 && sa.st_dev == sb.st_dev &&
+           sa.st_ino == sb.st_ino;
+}
+
+int Merge(const char* out, int count, const char* const* paths) {
+    // Appending a store to itself would read the rows it is writing.
+    for (int i = 0; i < count; ++i) {
+        if (SameFile(out, paths[i])) {
+            printf("Error: %s is both the output and an input of merge.\n", out);
+            return 1;
+        }
+    }
+    ResultsWriter writer;
+    if (!writer.Open(out)) {
+        return 1;
+    }
+    for (int i = 0; i < count; ++i) {
+        ResultsReader reader;
+        if (!reader.Open(paths[i])) {
+            return 1;
+        }
+        // The same configuration keeps one ID however many stores it appears in.
+        std::vector<uint32_t> remap(reader.ConfigCount());
+        for (uint32_t id = 0; id < reader.ConfigCount(); ++id) {
+            if (!writer.ConfigId(reader.ConfigName(id), &remap[id])) {
+                return 1;
+            }
+        }
+        for (uint32_t chunk = 0; chunk < reader.Chunks(); ++chunk) {
+            for (uint32_t r = 0; r < reader.ChunkRows(chunk); ++r) {
+                TrialRecord record = reader.Row(chunk, r);
+                if (record.configId >= remap.size()) {
+                    continue;
+                }
+                record.configId = remap[record.configId];
+                writer.Append(record);
+            }
+        }
+    }
+    printf("%s: %" PRIu64 " rows\n", out, writer.Rows());
+    return 0;
+}
+
+int Csv(const char* path) {
+    ResultsReader reader;
+    if (!reader.Open(path)) {
+        return 1;
+    }
+    const int config = reader.FindColumn("config");
+    for (uint32_t c = 0; c < reader.ColumnCount(); ++c) {
+        printf("%s%s", c ? "," : "", reader.ColumnSchema(c).name);
+    }
+    printf(",config_name\n");
+    for (uint32_t chunk = 0; chunk < reader.Chunks(); ++chunk) {
+        for (uint32_t r = 0; r < reader.ChunkRows(chunk); ++r) {
+            for (uint32_t c = 0; c < reader.ColumnCount(); ++c) {
+                const void* column = reader.Column(chunk, c);
+                printf("%s", c ? "," : "");
+                switch (reader.ColumnSchema(c).type) {
+                    case ColumnType::U64:
+                        printf("%" PRIu64, static_cast<const uint64_t*>(column)[r]);
+                        break;
+                    case ColumnType::F32:
+                        printf("%.4f", static_cast<const float*>(column)[r]);
+                        break;
+                    default:
+                        printf("%u", static_cast<const uint32_t*>(column)[r]);
+                        break;
+                }
+            }
+            const uint32_t id =
+                config < 0 ? 0 : static_cast<const uint32_t*>(reader.Column(chunk, config))[r];
+            // Quotes within a quoted field are doubled.
+            printf(",\"");
+            for (const char* c = reader.ConfigName(id); *c; ++c) {
+                if (*c == '"') {
+                    putchar('"');
+                }
+                putchar(*c);
+            }
+            printf("\"\n");
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    if (argc >= 3 && !strcmp(argv[1], "summary")) {
+        return Summary(argc - 2, argv + 2);
+    }
+    if (argc >= 4 && !strcmp(argv[1], "merge")) {
+        return Merge(argv[2], argc - 3, argv + 3);
+    }
+    if (argc == 3 && !strcmp(argv[1], "csv")) {
+        return Csv(argv[2]);
+    }
+    printf("Usage: %s summary <file>...\n", argv[0]);
+    printf("       %s merge <out> <file>...\n", argv[0]);
+    printf("       %s csv <file>\n", argv[0]);
+    printf("summary prints trials, failures, dispatch times, lookback polls and, for runs with\n"
+           "--perf, hardware counters per configuration across every file. merge appends the\n"
+           "files to out, which may already exist but must not be one of them. csv prints every row of a file.\n");
+    return 1;
+}
@@ -0,0 +1,113 @@
+#include "segmentedScan.h"
+
+#include <algorithm>
+
+#include "chainedScan.h"
+
+namespace {
+
+// The stress kernel's flags, moved to the top of a 64-bit word, plus the segment head bit.
+const uint64_t SEG_FLAG_READY = uint64_t(FLAG_READY) << 32;
+const uint64_t SEG_FLAG_INCLUSIVE = uint64_t(FLAG_INCLUSIVE) << 32;
+const uint64_t SEG_FLAG_MASK = uint64_t(FLAG_MASK) << 32;
+const uint64_t SEG_HEAD_SEEN = uint64_t(1) << 61;
+const uint64_t SEG_VALUE_MASK = 0xFFFFFFFFull;
+
+}  // namespace
+
+CpuSegmentedScan::CpuSegmentedScan(uint32_t workerCount, WaitPolicy waitPolicy)
+    : workerCount(workerCount ? workerCount : 1), waitPolicy(waitPolicy) {}
+
+void CpuSegmentedScan::Scan(const uint32_t* values, const uint8_t* heads, size_t n,
+                            uint32_t* out) {
+    const uint32_t tiles = (uint32_t)((n + TILE_ELEMENTS - 1) / TILE_ELEMENTS);
+    if (tiles > statusWords) {
+        statusWords = tiles;
+        status.reset(new std::atomic<uint64_t>[statusWords]);
+    }
+    for (uint32_t t = 0; t < tiles; ++t) {
+        status[t].store(0, std::memory_order_relaxed);
+    }
+    tileBump.store(0, std::memory_order_relaxed);
+
+    std::atomic<uint64_t> depth{0};
+    RunWorkers(std::max(1u, std::min(workerCount, tiles)), [&](uint32_t) {
+        uint64_t localDepth = 0;
+        while (true) {
+            const uint32_t tile = tileBump.fetch_add(1u, std::memory_order_relaxed);
+            if (tile >= tiles) {
+                break;
+            }
+            ScanTile(values, heads, n, out, tile, &localDepth);
+        }
+        depth.fetch_add(localDepth, std::memory_order_relaxed);
+    });
+    meanLookbackDepth = tiles ? double(depth.load()) / tiles : 0;
+}
+
+void CpuSegmentedScan::ScanTile(const uint32_t* values, const uint8_t* heads, size_t n,
+                                uint32_t* out, uint32_t tile, uint64_t* depth) {
+    const size_t begin = size_t(tile) * TILE_ELEMENTS;
+    const size_t end = std::min(n, begin + TILE_ELEMENTS);
+
+    // The tile's aggregate: the sum since its last head, or of the whole tile if it has none.
+    uint32_t trailing = 0;
+    bool headSeen = false;
+    for (size_t i = begin; i < end; ++i) {
+        if (heads[i]) {
+            trailing = 0;
+            headSeen = true;
+        }
+        trailing += values[i];
+    }
+
+    // A tile whose aggregate starts at a head needs nothing from its predecessors, so it can post
+    // the flag that stops every lookback right away.
+    std::atomic<uint64_t>& self = status[tile];
+    const uint64_t postFlag = tile == 0 ? SEG_FLAG_INCLUSIVE
+                                        : SEG_FLAG_READY | (headSeen ? SEG_HEAD_SEEN : 0);
+    self.store(postFlag | trailing, std::memory_order_relaxed);
+
+    // Only the elements before the tile's first head need a carry-in.
+    uint32_t carry = 0;
+    if (tile != 0 && !heads[begin]) {
+        uint32_t lookbackId = tile - 1;
+        Waiter waiter(waitPolicy, lot);
+        while (true) {
+            const uint64_t flagPayload = status[lookbackId].load(std::memory_order_relaxed);
+            const uint64_t flag = flagPayload & SEG_FLAG_MASK;
+            if (flag == 0) {
+                // 64-bit words are not futex-sized, so this wait never parks.
+                waiter.Pause();
+                continue;
+            }
+            ++*depth;
+            carry += (uint32_t)(flagPayload & SEG_VALUE_MASK);
+            if (flag == SEG_FLAG_INCLUSIVE || (flagPayload & SEG_HEAD_SEEN)) {
+                break;
+            }
+            lookbackId -= 1;
+            waiter.Reset();
+        }
+    }
+    if (tile != 0) {
+        const uint32_t inclusive = headSeen ? trailing : carry + trailing;
+        self.store(SEG_FLAG_INCLUSIVE | (headSeen ? SEG_HEAD_SEEN : 0) | inclusive,
+                   std::memory_order_relaxed);
+    }
+
+    uint32_t running = carry;
+    for (size_t i = begin; i < end; ++i) {
+        running = (heads[i] ? 0 : running) + values[i];
+        out[i] = running;
+    }
+}
+
+void SegmentedScanReference(const uint32_t* values, const uint8_t* heads, size_t n,
+                            uint32_t* out) {
+    uint32_t running = 0;
+    for (size_t i = 0; i < n; ++i) {
+        running = (heads[i] ? 0 : running) + values[i];
+        out[i] = running;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "waitPolicy.h"
+
+// Inclusive segmented sum scan of u32 values (mod 2^32), chained like the stress kernel. A segment
+// starts at every element whose head flag is set. Besides READY/INCLUSIVE, a tile's status entry
+// carries HEAD_SEEN when a segment starts inside the tile: its posted value is then the sum since
+// that head, which no predecessor can change, so a lookback stops there exactly as it would at an
+// INCLUSIVE tile. Short segments therefore also mean short lookbacks.
+class CpuSegmentedScan {
+   public:
+    explicit CpuSegmentedScan(uint32_t workerCount, WaitPolicy waitPolicy = WaitPolicy::Pause);
+
+    // out[i] = sum of values[j] for j from the last head at or before i (or 0) to i.
+    void Scan(const uint32_t* values, const uint8_t* heads, size_t n, uint32_t* out);
+
+    // Mean number of predecessor entries read per tile during the last Scan.
+    double MeanLookbackDepth() const { return meanLookbackDepth; }
+
+    static const uint32_t TILE_ELEMENTS = 4096;
+
+   private:
+    void ScanTile(const uint32_t* values, const uint8_t* heads, size_t n, uint32_t* out,
+                  uint32_t tile, uint64_t* depth);
+
+    uint32_t workerCount;
+    WaitPolicy waitPolicy;
+    ParkingLot lot;
+    std::atomic<uint32_t> tileBump{0};
+    // One 64-bit word per tile: flags in the top bits, the 32-bit partial sum in the low half.
+    std::unique_ptr<std::atomic<uint64_t>[]> status;
+    size_t statusWords = 0;
+    double meanLookbackDepth = 0;
+};
+
+// Sequential reference for validation.
+void SegmentedScanReference(const uint32_t* values, const uint8_t* heads, size_t n,
+                            uint32_t* out);
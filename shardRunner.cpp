@@ -0,0 +1,220 @@
+#include "shardRunner.h"
+
+#include <limits.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "placement.h"
+#include "trialRunner.h"
+
+static_assert(sizeof(TrialRecord) <= PIPE_BUF, "a record must go down the pipe in one write");
+
+namespace {
+
+// Restricts this process, and every thread it starts from here on, to cpus. macOS has no hard
+// affinity, so there the shards are left to the scheduler.
+void PinToCpus(const std::vector<uint32_t>& cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (uint32_t cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set)) {
+        printf("Failed to pin a shard to its CPUs; it runs unpinned.\n");
+    }
+#else
+    (void)cpus;
+#endif
+}
+
+// Runs shard s's trials, first to first + count - 1, and exits. Called in the child, before it
+// has started any thread.
+[[noreturn]] void RunShard(uint32_t shard, const CpuConfig& config, const ShardOptions& options,
+                           uint32_t first, uint32_t count, int fd) {
+    PinToCpus(ShardCpus(shard, options.shards));
+    {
+        NoiseConfig noise = options.noise;
+        noise.threads = (uint32_t)((uint64_t)options.noise.threads * (shard + 1) / options.shards -
+                                   (uint64_t)options.noise.threads * shard / options.shards);
+        NoiseGenerator generator(noise);
+        FailureWriter writer(std::string(options.failuresPath) + "." + std::to_string(shard));
+        RecordPipe pipe(fd);
+        TrialSinks sinks;
+        sinks.failures = &writer;
+        sinks.records = &pipe;
+        TrialRunner runner(config, options.concurrentTrials, options.seed, options.perfCounters);
+        runner.Run(first, count, options.stallIntervalMs, sinks, false);
+    }
+    close(fd);
+    fflush(stdout);
+    _exit(0);
+}
+
+// 95% Wilson score interval of a failure rate. Unlike the normal approximation it stays inside
+// [0, 1] and is useful with no failures at all, which is the common case.
+void WilsonInterval(uint64_t failed, uint64_t trials, double* low, double* high) {
+    const double z = 1.96;
+    const double n = static_cast<double>(trials);
+    const double p = failed / n;
+    const double scale = 1 + z * z / n;
+    const double center = (p + z * z / (2 * n)) / scale;
+    const double half = z * std::sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / scale;
+    // The bounds are exact at the extremes, where rounding would leave a residue.
+    *low = failed ? std::max(0.0, center - half) : 0.0;
+    *high = failed < trials ? std::min(1.0, center + half) : 1.0;
+}
+
+void PrintLiveReport(double seconds, uint32_t attempted, uint32_t failed, uint32_t total,
+                     uint32_t running) {
+    double low = 0;
+    double high = 1;
+    if (attempted) {
+        WilsonInterval(failed, attempted, &low, &high);
+    }
+    printf("[%7.1f s] %u / %u trials, %.1f trials/s, %u failed, rate %.3g (95%% CI %.3g-%.3g), "
+           "%u shards running\n",
+           seconds, attempted, total, seconds > 0 ? attempted / seconds : 0.0, failed,
+           attempted ? (double)failed / attempted : 0.0, low, high, running);
+    fflush(stdout);
+}
+
+}  // namespace
+
+void RecordPipe::Send(const TrialRecord& record) {
+    // A pipe write of at most PIPE_BUF bytes is all or nothing; only a signal can interrupt it.
+    while (write(fd, &record, sizeof(record)) < 0 && errno == EINTR) {
+    }
+}
+
+std::vector<uint32_t> ShardCpus(uint32_t shard, uint32_t shards) {
+    const std::vector<uint32_t> cpus = AllowedCpus();
+    const size_t count = cpus.size();
+    if (shards > count) {
+        return {cpus[shard % count]};
+    }
+    return std::vector<uint32_t>(cpus.begin() + count * shard / shards,
+                                 cpus.begin() + count * (shard + 1) / shards);
+}
+
+bool RunShards(const CpuConfig& config, const ShardOptions& options, ResultsWriter* results,
+               uint32_t configId, CampaignState* state) {
+    int fds[2];
+    if (pipe(fds)) {
+        printf("Failed to create the shard pipe.\n");
+        return false;
+    }
+    // Anything still buffered would be written again by every child.
+    fflush(stdout);
+    std::vector<pid_t> pids;
+    for (uint32_t s = 0; s < options.shards; ++s) {
+        const uint32_t first = (uint32_t)((uint64_t)options.trials * s / options.shards);
+        const uint32_t end = (uint32_t)((uint64_t)options.trials * (s + 1) / options.shards);
+        const pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            RunShard(s, config, options, first + 1, end - first, fds[1]);
+        }
+        if (pid < 0) {
+            printf("Failed to start shard %u.\n", s);
+            for (pid_t started : pids) {
+                kill(started, SIGTERM);
+                waitpid(started, nullptr, 0);
+            }
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+        pids.push_back(pid);
+    }
+    // The read end sees end of file once every shard has exited.
+    close(fds[1]);
+
+    const auto start = std::chrono::steady_clock::now();
+    auto nextReport = start + std::chrono::seconds(SHARD_REPORT_INTERVAL_S);
+    auto elapsed = [&] {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    const uint32_t batchSize = 64;
+    TrialRecord batch[batchSize];
+    size_t filled = 0;
+    uint32_t failed = 0;
+    std::vector<int> statuses(options.shards, 0);
+    std::vector<bool> exited(options.shards, false);
+    while (true) {
+        const auto untilReport = std::chrono::duration_cast<std::chrono::milliseconds>(
+            nextReport - std::chrono::steady_clock::now());
+        pollfd readable = {fds[0], POLLIN, 0};
+        if (poll(&readable, 1, std::max(0, (int)untilReport.count())) > 0) {
+            const ssize_t got =
+                read(fds[0], reinterpret_cast<char*>(batch) + filled, sizeof(batch) - filled);
+            if (got == 0) {
+                break;
+            }
+            if (got < 0 && errno != EINTR) {
+                printf("Failed to read from the shards.\n");
+                break;
+            }
+            filled += std::max<ssize_t>(got, 0);
+            const size_t records = filled / sizeof(TrialRecord);
+            for (size_t r = 0; r < records; ++r) {
+                TrialRecord& record = batch[r];
+                state->attempted++;
+                if (record.failed) {
+                    failed++;
+                    state->AddFailing(record.trial, record.seed);
+                    if (!state->firstFailure || record.trial < state->firstFailure) {
+                        state->firstFailure = record.trial;
+                    }
+                } else {
+                    state->passed++;
+                }
+                if (results) {
+                    record.configId = configId;
+                    results->Append(record);
+                }
+            }
+            filled -= records * sizeof(TrialRecord);
+            memmove(batch, reinterpret_cast<char*>(batch) + records * sizeof(TrialRecord),
+                    filled);
+        }
+        if (std::chrono::steady_clock::now() >= nextReport) {
+            uint32_t running = 0;
+            for (uint32_t s = 0; s < options.shards; ++s) {
+                if (!exited[s] && waitpid(pids[s], &statuses[s], WNOHANG) == pids[s]) {
+                    exited[s] = true;
+                }
+                running += !exited[s];
+            }
+            PrintLiveReport(elapsed(), state->attempted, failed, options.trials, running);
+            nextReport += std::chrono::seconds(SHARD_REPORT_INTERVAL_S);
+        }
+    }
+    close(fds[0]);
+    state->seconds = elapsed();
+    state->nextTrial = state->batchSize + 1;
+    PrintLiveReport(state->seconds, state->attempted, failed, options.trials, 0);
+
+    bool clean = true;
+    for (uint32_t s = 0; s < options.shards; ++s) {
+        if (!exited[s]) {
+            waitpid(pids[s], &statuses[s], 0);
+        }
+        if (!WIFEXITED(statuses[s]) || WEXITSTATUS(statuses[s])) {
+            printf("Shard %u died; its remaining trials were not run.\n", s);
+            clean = false;
+        }
+    }
+    return clean && state->attempted == options.trials;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "checkpoint.h"
+#include "cpuBackend.h"
+#include "noiseWorkload.h"
+#include "resultsStore.h"
+
+// A campaign split across worker processes, for failure-rate statistics over millions of trials.
+// The launcher forks one process per shard, each pinned to its own subset of the CPUs and running
+// a contiguous range of the campaign's trials on a TrialRunner of its own. Trial n keeps the seed
+// TrialSeed(seed, n) whichever shard runs it, so the shards cover disjoint seed ranges and any
+// trial can be rerun alone in a single process. Every trial's TrialRecord is streamed back over
+// one pipe, and the launcher merges them into a live report and, if given one, a results store.
+// Shards keep going past a failure: the point is the rate.
+
+struct ShardOptions {
+    uint32_t shards = 1;
+    uint32_t trials = 0;
+    uint32_t concurrentTrials = 1;  // Per shard.
+    uint32_t stallIntervalMs = 0;
+    uint64_t seed = 0;
+    // Shard s writes its failure records to failuresPath + "." + s.
+    const char* failuresPath = FAILURE_LOG_PATH;
+    // Split across the shards, each running its share on its own CPUs.
+    NoiseConfig noise;
+    bool perfCounters = false;  // Count hardware events per trial; see TrialRunner.
+};
+
+// Seconds between lines of the live report.
+const uint32_t SHARD_REPORT_INTERVAL_S = 2;
+
+// The write end of the pipe from a shard to the launcher. A record is sent in a single write of at
+// most PIPE_BUF bytes, which POSIX makes atomic, so every runner thread of every shard can share
+// the one pipe without a lock.
+class RecordPipe {
+   public:
+    explicit RecordPipe(int fd) : fd(fd) {}
+    void Send(const TrialRecord& record);
+
+   private:
+    int fd;
+};
+
+// The CPUs shard s of shards runs on: an equal contiguous share of the online CPUs, or one CPU
+// shared round-robin when there are more shards than CPUs.
+std::vector<uint32_t> ShardCpus(uint32_t shard, uint32_t shards);
+
+// Runs the campaign in options.shards processes and returns its outcome: every failing trial, with
+// its seed, and firstFailure the lowest of them. Records go to results under configId when results
+// is non-null. Prints the reason and returns false if a shard could not be started or died.
+bool RunShards(const CpuConfig& config, const ShardOptions& options, ResultsWriter* results,
+               uint32_t configId, CampaignState* state);
@@ -0,0 +1,35 @@
+#include "stallMonitor.h"
+
+#include <algorithm>
+#include <cstdio>
+
+StallMonitor::StallMonitor(uint32_t intervalMs, uint32_t tileCount)
+    : interval(intervalMs), lastAdvance(std::chrono::steady_clock::now()), tileCount(tileCount) {}
+
+std::chrono::microseconds StallMonitor::PollPeriod() const {
+    // Poll several times per interval so a stall is reported close to the deadline, but never
+    // spin faster than once per millisecond.
+    return std::max(std::chrono::microseconds(1000),
+                    std::chrono::duration_cast<std::chrono::microseconds>(interval) / 8);
+}
+
+bool StallMonitor::Observe(const ProgressSnapshot& snapshot) {
+    const auto now = std::chrono::steady_clock::now();
+    if (snapshot.inclusive != lastInclusive) {
+        lastInclusive = snapshot.inclusive;
+        lastAdvance = now;
+        return false;
+    }
+    if (reported || snapshot.inclusive >= tileCount || now - lastAdvance < interval) {
+        return false;
+    }
+    reported = true;
+    return true;
+}
+
+void PrintStallReport(const ProgressSnapshot& snapshot, uint32_t intervalMs, uint32_t tileCount) {
+    printf("Stall detected: no tile has posted INCLUSIVE for %u ms.\n"
+           "  Tiles posted INCLUSIVE:            %u / %u\n"
+           "  Tiles posted READY or INCLUSIVE:   %u / %u\n",
+           intervalMs, snapshot.inclusive, tileCount, snapshot.posted, tileCount);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "common.h"
+
+// One poll of the progress buffer. See PROGRESS_INCLUSIVE and PROGRESS_POSTED in common.h.
+struct ProgressSnapshot {
+    uint32_t inclusive;  // Tiles that have posted INCLUSIVE, in no particular order.
+    uint32_t posted;     // Tiles that have posted at least READY.
+};
+
+// Watches the INCLUSIVE count of a running trial. The owner polls the progress counters and feeds
+// them in; if the count stops advancing for longer than the interval, Observe reports a stall
+// exactly once per trial so the backend can dump the state of the blocking tile.
+class StallMonitor {
+   public:
+    // tileCount is the size of the dispatch; an INCLUSIVE count that has reached it is finished.
+    explicit StallMonitor(uint32_t intervalMs, uint32_t tileCount = TEST_SIZE);
+
+    // Polling period the owner should sleep between calls to Observe.
+    std::chrono::microseconds PollPeriod() const;
+
+    // Returns true the first time the INCLUSIVE count has been stuck for the configured interval.
+    bool Observe(const ProgressSnapshot& snapshot);
+
+   private:
+    std::chrono::milliseconds interval;
+    std::chrono::steady_clock::time_point lastAdvance;
+    uint32_t tileCount;
+    uint32_t lastInclusive = 0;
+    bool reported = false;
+};
+
+// Prints the monitor's summary line and the counts, which name no tile. Backends follow it with
+// whatever per-tile state they can see.
+void PrintStallReport(const ProgressSnapshot& snapshot, uint32_t intervalMs,
+                      uint32_t tileCount = TEST_SIZE);
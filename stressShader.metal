@@ -2,13 +2,11 @@
 using namespace metal;
 
 // Must exactly match the host code.
-constant uint SPLIT_THREADS = 2;
 constant uint FLAG_NOT_READY = 0;
 constant uint FLAG_READY = 0x40000000;
 constant uint FLAG_INCLUSIVE = 0x80000000;
 constant uint FLAG_MASK = 0xC0000000;
 constant uint VALUE_MASK = 0xffff;
-constant uint SPLIT_READY = 3;
 
 // We choose a workgroup dimension with the exact size of an Apple subgroup (typically 32)
 // to ensure subgroup operations behave as expected.
@@ -17,70 +15,153 @@ constant uint ERROR_TYPE_MESSAGE = 1u;
 constant uint ERROR_TYPE_SHUFFLE_READY = 2u;
 constant uint ERROR_TYPE_SHUFFLE_INC = 3u;
 constant uint ERROR_TYPE_SGSIZE = 4u;
+constant uint PROGRESS_INCLUSIVE = 0;
+constant uint PROGRESS_POSTED = 1;
+constant uint MEMORY_ORDER_RELAXED = 0;
+constant uint MEMORY_ORDER_ACQ_REL = 1;
+constant uint MEMORY_ORDER_SEQ_CST = 2;
+
+// Memory order of the scan buffer accesses, chosen by the host when it builds the pipeline. The
+// default, relaxed, is the kernel as originally written.
+constant uint MEMORY_ORDER_ARG [[function_constant(0)]];
+constant uint MEMORY_ORDER =
+    is_function_constant_defined(MEMORY_ORDER_ARG) ? MEMORY_ORDER_ARG : MEMORY_ORDER_RELAXED;
+
+// Batched mode: the dispatch runs independent scans of TILES_PER_SCAN tiles each, all fed by the
+// one scan_bump. Tile n is tile n % TILES_PER_SCAN of its scan; the first tile of each scan is a
+// chain root and posts INCLUSIVE, so lookback never crosses into the previous scan. The default is
+// a single scan over the whole buffer.
+constant uint TILES_PER_SCAN_ARG [[function_constant(1)]];
+constant uint TILES_PER_SCAN =
+    is_function_constant_defined(TILES_PER_SCAN_ARG) ? TILES_PER_SCAN_ARG : 65535;
+
+// Multi-split payloads: the number of split lanes, 2 (the default, a u32 value), 4 or 8. A tile's
+// aggregate is SPLIT_THREADS / 2 independent u32 words (e.g. a sum and a count) in a uint4; lane
+// tid carries the 16-bit half tid & 1 of word tid / 2. SPLIT_READY, the ballot of every split
+// lane, follows from it.
+constant uint SPLIT_THREADS_ARG [[function_constant(2)]];
+constant uint SPLIT_THREADS =
+    is_function_constant_defined(SPLIT_THREADS_ARG) ? SPLIT_THREADS_ARG : 2;
+constant uint SPLIT_READY = (1u << SPLIT_THREADS) - 1;
+constant uint AGGREGATE_WORDS = SPLIT_THREADS / 2;
+
+// Whether the lookback runs its validation checks (messagePassingCheck and the shuffle checks).
+// Each call site tests CHECKS first, so with it false the compiler removes the checks and the
+// errEncountered bookkeeping entirely. Together with MEMORY_ORDER, TILES_PER_SCAN and
+// SPLIT_THREADS this makes every pipeline the host builds a separately specialized kernel.
+constant bool CHECKS_ARG [[function_constant(3)]];
+constant bool CHECKS = is_function_constant_defined(CHECKS_ARG) ? CHECKS_ARG : true;
+
+// Whether the kernel publishes its progress for the host's stall monitor. The host sets it only
+// when it polls, so an unmonitored run is the kernel without the progress atomics.
+constant bool PROGRESS_ARG [[function_constant(4)]];
+constant bool PROGRESS = is_function_constant_defined(PROGRESS_ARG) ? PROGRESS_ARG : false;
+
+// Every tile's reduction. Word 0 is the original 1024; word w is 1024 * (w + 1), so a lane that
+// reads the wrong word is caught. Must match TileWord() on the host.
+constant uint4 TILE_REDUCTION = uint4(1024, 2048, 3072, 4096);
 
 // Get the ballot back as a uint. Lop off the upper bits, as we require a 32 simdgroup size, and
 // will never need them. WGSL equivalent: subgroupBallot(pred).x
 uint ballot(bool pred) { return as_type<uint2>((simd_vote::vote_t)simd_ballot(pred)).x; }
 
-// Once the flags of both split threads match, "join" the values together by a one-step butterfly
-// shuffle followed by bit manipulation. Post-join, both split threads MUST have the same result.
-uint join(uint mine, uint tid) {
-    const uint xord = tid ^ 1;
-    const uint theirs = simd_shuffle(mine, xord);  // WGSL: unsafeShuffle(mine, xor)
-    return mine << 16 * tid | theirs << 16 * xord;
+// Once the flags of every split thread match, gather the values together: one shuffle per split
+// lane, each placing that lane's 16 bits into its word of the aggregate. With two lanes this is the
+// original one-step join. Post-gather, all split threads MUST have the same result.
+uint4 gather(uint mine) {
+    uint4 agg = 0;
+    for (uint lane = 0; lane < SPLIT_THREADS; ++lane) {
+        agg[lane / 2] |= simd_shuffle(mine, lane) << 16 * (lane & 1);  // WGSL: subgroupShuffle
+    }
+    return agg;
 }
 
-// Prior to storing the values in global memory, split the value into its constituent 16-bit parts.
-uint split(uint x, uint tid) { return x >> tid * 16 & VALUE_MASK; }
+// Prior to storing the values in global memory, split the aggregate into its constituent 16-bit
+// parts; lane tid takes its half of its word.
+uint split(uint4 x, uint tid) { return x[tid / 2] >> (tid & 1) * 16 & VALUE_MASK; }
 
-// The error buffer is made up of array<uint2, 2>. Each thread of every tile may post an error code
-// and the incorrect value it found. Because one downstream incorrect results in errors in all
-// upstream results, we are primarily interested in the FIRST incorrect error code.
-typedef uint2 errType[2];
+// Index of the first word of the aggregate that differs from expected, or AGGREGATE_WORDS.
+uint firstMismatch(uint4 got, uint4 expected) {
+    for (uint w = 0; w < AGGREGATE_WORDS; ++w) {
+        if (got[w] != expected[w]) {
+            return w;
+        }
+    }
+    return AGGREGATE_WORDS;
+}
+
+// Device atomics only take memory_order_relaxed, so the stronger orders are built from a relaxed
+// access plus a device-scope fence: release/seq_cst before a store, acquire/seq_cst after a load.
+// MEMORY_ORDER is a function constant, so the relaxed variant compiles to the bare access.
+uint loadScan(device atomic_uint* p) {
+    const uint v = atomic_load_explicit(p, memory_order_relaxed);
+    if (MEMORY_ORDER == MEMORY_ORDER_ACQ_REL) {
+        atomic_thread_fence(mem_flags::mem_device, memory_order_acquire, thread_scope_device);
+    } else if (MEMORY_ORDER == MEMORY_ORDER_SEQ_CST) {
+        atomic_thread_fence(mem_flags::mem_device, memory_order_seq_cst, thread_scope_device);
+    }
+    return v;
+}
+
+void storeScan(device atomic_uint* p, uint v) {
+    if (MEMORY_ORDER == MEMORY_ORDER_ACQ_REL) {
+        atomic_thread_fence(mem_flags::mem_device, memory_order_release, thread_scope_device);
+    } else if (MEMORY_ORDER == MEMORY_ORDER_SEQ_CST) {
+        atomic_thread_fence(mem_flags::mem_device, memory_order_seq_cst, thread_scope_device);
+    }
+    atomic_store_explicit(p, v, memory_order_relaxed);
+}
+
+// The error buffer is made up of array<uint2, SPLIT_THREADS>, indexed by errorIndex(). Each split
+// thread of every tile may post an error code and the incorrect value it found. Because one
+// downstream incorrect results in errors in all upstream results, we are primarily interested in
+// the FIRST incorrect error code.
+uint errorIndex(uint tile_id, uint tid) { return tile_id * SPLIT_THREADS + tid; }
+
+// The scan buffer is scan[tile_id][split_thread_index], flattened for a variable lane count.
+uint scanIndex(uint tile_id, uint tid) { return tile_id * SPLIT_THREADS + tid; }
 
 // Checks the flag_payload loaded from global memory after every load.
 // Because the inputs are constant, each tile has only 3 valid values:
 bool messagePassingCheck(uint tid, uint flag_payload, uint lookback_id, uint tile_id,
-                         device errType* errors) {
+                         device uint2* errors) {
     bool is_valid_payload =
         (flag_payload == FLAG_NOT_READY ||
-         flag_payload == (split(1024, tid) | FLAG_READY) ||
-         flag_payload == (split((lookback_id + 1) * 1024, tid) | FLAG_INCLUSIVE));
+         flag_payload == (split(TILE_REDUCTION, tid) | FLAG_READY) ||
+         flag_payload ==
+             (split((lookback_id % TILES_PER_SCAN + 1) * TILE_REDUCTION, tid) | FLAG_INCLUSIVE));
     if (!is_valid_payload) {
-        errors[tile_id][tid].x = ERROR_TYPE_MESSAGE;
-        errors[tile_id][tid].y = flag_payload;
+        errors[errorIndex(tile_id, tid)] = uint2(ERROR_TYPE_MESSAGE, flag_payload);
         return true;
     }
     return false;
 }
 
-// Checks the post-joined value in the "both flags ready" branch. If a valid data was passed between
-// workgroups, then the post shuffle value must exactly match the expected sum. This branch is taken
-// when both split threads signal READY (but not INCLUSIVE). This branch performs less atomic
-// operations, so it may be less liable to encounter errors.
-bool shuffleCheckReady(uint tid, uint prev_red, uint lookback_id, uint tile_id,
-                       device errType* errors) {
-    uint expected_value = (tile_id - lookback_id) * 1024;
-    if (prev_red != expected_value) {
-        errors[tile_id][tid].x = ERROR_TYPE_SHUFFLE_READY;
-        errors[tile_id][tid].y = prev_red;
+// Checks the post-gathered value in the "all flags ready" branch. If a valid data was passed
+// between workgroups, then the post shuffle value must exactly match the expected sum. This branch
+// is taken when every split thread signals READY (but not INCLUSIVE). This branch performs less
+// atomic operations, so it may be less liable to encounter errors. The first wrong word is posted.
+bool shuffleCheckReady(uint tid, uint4 prev_red, uint lookback_id, uint tile_id,
+                       device uint2* errors) {
+    const uint w = firstMismatch(prev_red, (tile_id - lookback_id) * TILE_REDUCTION);
+    if (w != AGGREGATE_WORDS) {
+        errors[errorIndex(tile_id, tid)] = uint2(ERROR_TYPE_SHUFFLE_READY, prev_red[w]);
         return true;
     }
     return false;
 }
 
-// Checks the post-joined value in the "both flags inclusive" branch. If a valid data was passed
+// Checks the post-gathered value in the "all flags inclusive" branch. If a valid data was passed
 // (especially after waiting for matching INCLUSIVE flags), then the post shuffle value must exactly
-// match the expected sum. This branch is taken when both split threads have signaled INCLUSIVE.
-// When a single inclusive flag is encountered initially, threads must wait until the matching pair
-// is also INCLUSIVE, resulting in increased atomic operations, and more opportunities for issues
-// before this check.
-bool shuffleCheckInclusive(uint tid, uint prev_red, uint lookback_id, uint tile_id,
-                           device errType* errors) {
-    uint expected_value = tile_id * 1024;
-    if (prev_red != expected_value) {
-        errors[tile_id][tid].x = ERROR_TYPE_SHUFFLE_INC;
-        errors[tile_id][tid].y = prev_red;
+// match the expected sum. This branch is taken when every split thread has signaled INCLUSIVE.
+// When a single inclusive flag is encountered initially, threads must wait until the other split
+// threads are also INCLUSIVE, resulting in increased atomic operations, and more opportunities for
+// issues before this check.
+bool shuffleCheckInclusive(uint tid, uint4 prev_red, uint lookback_id, uint tile_id,
+                           device uint2* errors) {
+    const uint w = firstMismatch(prev_red, tile_id % TILES_PER_SCAN * TILE_REDUCTION);
+    if (w != AGGREGATE_WORDS) {
+        errors[errorIndex(tile_id, tid)] = uint2(ERROR_TYPE_SHUFFLE_INC, prev_red[w]);
         return true;
     }
     return false;
@@ -89,15 +170,15 @@ bool shuffleCheckInclusive(uint tid, uint prev_red, uint lookback_id, uint tile_
 // This kernel runs the inter-workgroup portion of a Chained-Scan with Lookback. It does not include
 // any fallback routine, so running it on devices without FPG may result in unexpected behavior. In
 // our case we use this scenario to check for simdgroup divergence or message passing issues.
-typedef atomic_uint splitType[2];
 kernel void stress(uint3 threadid [[thread_position_in_threadgroup]],
                    uint laneid [[thread_index_in_simdgroup]],
                    uint sgSize [[threads_per_simdgroup]],
                    device atomic_uint* scan_bump [[buffer(0)]],
-                   device splitType* scan [[buffer(1)]],
-                   device errType* errors [[buffer(2)]]) {
+                   device atomic_uint* scan [[buffer(1)]],
+                   device uint2* errors [[buffer(2)]],
+                   device atomic_uint* progress [[buffer(3)]]) {
     if (BLOCK_DIM != sgSize) {
-        errors[0][0].x = ERROR_TYPE_SGSIZE;
+        errors[0].x = ERROR_TYPE_SGSIZE;
         return;
     }
     const bool is_split_thread = threadid.x < SPLIT_THREADS;
@@ -111,6 +192,7 @@ kernel void stress(uint3 threadid [[thread_position_in_threadgroup]],
     // Safety barrier, don't want possible divergence here before broadcast.
     threadgroup_barrier(mem_flags::mem_threadgroup);
     tile_id = simd_broadcast(tile_id, 0);
+    const uint chain_tile = tile_id % TILES_PER_SCAN;
 
     // The split threads post the values into global memory. The first tile posts FLAG_INCLUSIVE
     // because it has no predecessor tiles, so it already contains the inclusive reduction of
@@ -136,9 +218,23 @@ kernel void stress(uint3 threadid [[thread_position_in_threadgroup]],
     // 1024u). Initially, only Tile 0 gets FLAG_INCLUSIVE. Other tiles get FLAG_READY. These flags
     // can be updated to FLAG_INCLUSIVE later during the lookback phase.
     //
+    // With more split threads, rows [2w] and [2w + 1] hold the LSBs/MSBs of word w of the
+    // aggregate, TILE_REDUCTION[w].
+    //
     if (is_split_thread) {
-        const uint t = split(1024, threadid.x) | (tile_id == 0 ? FLAG_INCLUSIVE : FLAG_READY);
-        atomic_store_explicit(&scan[tile_id][threadid.x], t, memory_order_relaxed);
+        const uint t =
+            split(TILE_REDUCTION, threadid.x) | (chain_tile == 0 ? FLAG_INCLUSIVE : FLAG_READY);
+        storeScan(&scan[scanIndex(tile_id, threadid.x)], t);
+    }
+
+    // Publish progress to the host-polled, shared-storage progress buffer. The host only watches
+    // whether the totals move; tiles post INCLUSIVE out of order, so they name no tile. One relaxed
+    // atomic per tile per counter, and none unless monitored.
+    if (PROGRESS && threadid.x == 0) {
+        atomic_fetch_add_explicit(&progress[PROGRESS_POSTED], 1u, memory_order_relaxed);
+        if (chain_tile == 0) {
+            atomic_fetch_add_explicit(&progress[PROGRESS_INCLUSIVE], 1u, memory_order_relaxed);
+        }
     }
 
     // The goal of lookback is for each workgroup to traverse backwards along the scan buffer,
@@ -163,13 +259,13 @@ kernel void stress(uint3 threadid [[thread_position_in_threadgroup]],
     // increased stress on the memory system.
 
     // The first workgroup (tile_id == 0), already has posted its FLAG_INCLUSIVE, so it skips this
-    // lookback operation.
-    if (tile_id != 0) {
+    // lookback operation. In batched mode the same holds for the first tile of every scan.
+    if (chain_tile != 0) {
         // This holds the reduction of the previous tiles. Each split thread maintains its own copy
-        // of this accumulating sum. Note value is not "split" initially---it is the full u32 sum.
-        // Modifications to it must operate on the full u32 value. Thus, prior to adding a
-        // value from a predecessor tile (which is stored split), we must "join" the split parts.
-        uint prev_red = 0;
+        // of this accumulating sum. Note value is not "split" initially---it is the full aggregate.
+        // Modifications to it must operate on the full aggregate. Thus, prior to adding a
+        // value from a predecessor tile (which is stored split), we must "gather" the split parts.
+        uint4 prev_red = 0;
 
         // Each workgroup begins its traversal with its immediate predecessor tile.
         uint lookback_id = tile_id - 1;
@@ -180,71 +276,74 @@ kernel void stress(uint3 threadid [[thread_position_in_threadgroup]],
             // (scan[lookback_id]). Non-split threads get a 0, as they don't participate in
             // loading/processing this data.
             uint flag_payload =
-                is_split_thread
-                    ? atomic_load_explicit(&scan[lookback_id][threadid.x], memory_order_relaxed)
-                    : 0;
+                is_split_thread ? loadScan(&scan[scanIndex(lookback_id, threadid.x)]) : 0;
 
-            if (!errEncountered && is_split_thread) {
+            if (CHECKS && !errEncountered && is_split_thread) {
                 errEncountered =
                     messagePassingCheck(threadid.x, flag_payload, lookback_id, tile_id, errors);
             }
 
-            // Next, the split threads check (via ballot) if both threads loaded a flag indicating
-            // data is READY or INCLUSIVE. SPLIT_READY (3, which is 0b11) means both of the first
-            // two threads in the ballot (our split threads) voted true.
+            // Next, the split threads check (via ballot) if all of them loaded a flag indicating
+            // data is READY or INCLUSIVE. SPLIT_READY (3, which is 0b11, for two split threads)
+            // means every one of the first SPLIT_THREADS threads in the ballot voted true.
             if (ballot((flag_payload & FLAG_MASK) > FLAG_NOT_READY) == SPLIT_READY) {
-                // Both split threads have found data that is at least READY.
+                // All split threads have found data that is at least READY.
                 // Now, check if an INCLUSIVE flag was loaded by any of the split threads.
                 uint inc_bal = ballot((flag_payload & FLAG_MASK) == FLAG_INCLUSIVE);
 
                 // Because states change in a strict order NOT_READY -> READY -> INCLUSIVE and never
                 // revert, once an INCLUSIVE is read by one split thread, we have no other choice
-                // but to wait until its matching pair (the other split thread) also reads an
-                // INCLUSIVE state from its part of the scan entry.
+                // but to wait until the other split threads also read an INCLUSIVE state from their
+                // parts of the scan entry.
                 if (inc_bal != 0) {  // At least one split thread read INCLUSIVE.
                     while (inc_bal !=
-                           SPLIT_READY) {  // Wait until *both* split threads read INCLUSIVE.
+                           SPLIT_READY) {  // Wait until *all* split threads read INCLUSIVE.
                         // Spin-load until the condition is met.
-                        flag_payload = is_split_thread
-                                           ? atomic_load_explicit(&scan[lookback_id][threadid.x],
-                                                                  memory_order_relaxed)
-                                           : 0;
+                        flag_payload =
+                            is_split_thread ? loadScan(&scan[scanIndex(lookback_id, threadid.x)])
+                                            : 0;
                         inc_bal = ballot((flag_payload & FLAG_MASK) == FLAG_INCLUSIVE);
                     }
 
-                    // Both threads have now loaded INCLUSIVE from scan[lookback_id].
-                    if (!errEncountered && is_split_thread) {
+                    // All split threads have now loaded INCLUSIVE from scan[lookback_id].
+                    if (CHECKS && !errEncountered && is_split_thread) {
                         errEncountered = messagePassingCheck(threadid.x, flag_payload, lookback_id,
                                                              tile_id, errors);
                     }
 
-                    // Once both threads have loaded INCLUSIVE, rejoin the value parts. Each split
-                    // thread calculates the joined value from its part and the other's part.
+                    // Once all split threads have loaded INCLUSIVE, gather the value parts. Each
+                    // split thread assembles the whole aggregate from every split thread's part.
                     // (flag_payload & VALUE_MASK) extracts the 16-bit data part.
-                    prev_red += join(flag_payload & VALUE_MASK, threadid.x);
-                    if (!errEncountered && is_split_thread) {
+                    prev_red += gather(flag_payload & VALUE_MASK);
+                    if (CHECKS && !errEncountered && is_split_thread) {
                         errEncountered = shuffleCheckInclusive(threadid.x, prev_red, lookback_id,
                                                                tile_id, errors);
                     }
 
                     // The lookback has found an inclusive sum. This 'prev_red' is the sum of all
-                    // tiles *before* the current one. Add this tile's own contribution (1024) to
-                    // 'prev_red' to get the inclusive sum *for this tile*. Then, split this new
-                    // inclusive sum, pack it with FLAG_INCLUSIVE, and post to global memory for
-                    // this tile.
+                    // tiles *before* the current one. Add this tile's own contribution
+                    // (TILE_REDUCTION, 1024 for two split threads) to 'prev_red' to get the
+                    // inclusive sum *for this tile*. Then, split this new inclusive sum, pack it
+                    // with FLAG_INCLUSIVE, and post to global memory for this tile.
                     if (is_split_thread) {
-                        const uint t = split(prev_red + 1024, threadid.x) | FLAG_INCLUSIVE;
-                        atomic_store_explicit(&scan[tile_id][threadid.x], t, memory_order_relaxed);
+                        const uint t =
+                            split(prev_red + TILE_REDUCTION, threadid.x) | FLAG_INCLUSIVE;
+                        storeScan(&scan[scanIndex(tile_id, threadid.x)], t);
+                    }
+                    if (PROGRESS && threadid.x == 0) {
+                        atomic_fetch_add_explicit(&progress[PROGRESS_INCLUSIVE], 1u,
+                                                  memory_order_relaxed);
                     }
 
                     // The lookback is complete for this workgroup, exit the while loop.
                     break;
                 } else {
-                    // Both threads loaded flags greater than NOT_READY, but neither were INCLUSIVE.
-                    // This means both threads must have loaded READY.
-                    // Join the value from scan[lookback_id] and add it to the reduction 'prev_red'.
-                    prev_red += join(flag_payload & VALUE_MASK, threadid.x);
-                    if (!errEncountered && is_split_thread) {
+                    // All split threads loaded flags greater than NOT_READY, but none were
+                    // INCLUSIVE. This means they must all have loaded READY.
+                    // Gather the value from scan[lookback_id] and add it to the reduction
+                    // 'prev_red'.
+                    prev_red += gather(flag_payload & VALUE_MASK);
+                    if (CHECKS && !errEncountered && is_split_thread) {
                         errEncountered =
                             shuffleCheckReady(threadid.x, prev_red, lookback_id, tile_id, errors);
                     }
@@ -0,0 +1,82 @@
+#include "tileAllocator.h"
+
+#include <cstring>
+
+#include "waitPolicy.h"
+
+namespace {
+
+const char* const TILE_ALLOCATION_NAMES[] = {"bump", "batched", "cluster"};
+
+// Base of a cluster grant that has never been filled. No refill can return it.
+const uint64_t NO_BASE = 0xFFFFFFFFull;
+
+}  // namespace
+
+const char* TileAllocationName(TileAllocation allocation) {
+    return TILE_ALLOCATION_NAMES[static_cast<int>(allocation)];
+}
+
+bool ParseTileAllocation(const char* name, TileAllocation* out) {
+    for (int i = 0; i < static_cast<int>(TileAllocation::Count); ++i) {
+        if (!strcmp(name, TILE_ALLOCATION_NAMES[i])) {
+            *out = static_cast<TileAllocation>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+TileAllocator::TileAllocator(TileAllocation allocation, uint32_t workerCount)
+    : allocation(allocation),
+      clusterCount((workerCount + CLUSTER_WORKERS - 1) / CLUSTER_WORKERS),
+      clusters(new ClusterGrant[clusterCount]) {
+    Reset();
+}
+
+void TileAllocator::Reset() {
+    scanBump.store(0, std::memory_order_relaxed);
+    // An exhausted grant on no base, so the first member to arrive refills it.
+    for (uint32_t c = 0; c < clusterCount; ++c) {
+        clusters[c].grant.store(NO_BASE << 32 | CLUSTER_GRANT_TILES, std::memory_order_relaxed);
+    }
+}
+
+uint32_t TileAllocator::Next(uint32_t workerIndex, Cursor& cursor, uint32_t limit) {
+    switch (allocation) {
+        case TileAllocation::Batched:
+            if (cursor.next == cursor.end) {
+                cursor.next = scanBump.fetch_add(GRANT_TILES, std::memory_order_relaxed);
+                cursor.end = cursor.next + GRANT_TILES;
+            }
+            return cursor.next < limit ? cursor.next++ : limit;
+        case TileAllocation::Clustered:
+            return NextClustered(workerIndex, limit);
+        default:
+            return scanBump.fetch_add(1u, std::memory_order_relaxed);
+    }
+}
+
+uint32_t TileAllocator::NextClustered(uint32_t workerIndex, uint32_t limit) {
+    std::atomic<uint64_t>& grant = clusters[workerIndex / CLUSTER_WORKERS].grant;
+    while (true) {
+        const uint64_t taken = grant.fetch_add(1u, std::memory_order_acq_rel);
+        const uint64_t base = taken >> 32;
+        const uint32_t used = static_cast<uint32_t>(taken);
+        if (used < CLUSTER_GRANT_TILES) {
+            const uint64_t tile = base + used;
+            return tile < limit ? static_cast<uint32_t>(tile) : limit;
+        }
+        if (used == CLUSTER_GRANT_TILES) {
+            // This member refills. It keeps the first ID of the new grant for itself.
+            const uint64_t fresh =
+                scanBump.fetch_add(CLUSTER_GRANT_TILES, std::memory_order_relaxed);
+            grant.store(fresh << 32 | 1u, std::memory_order_release);
+            return fresh < limit ? static_cast<uint32_t>(fresh) : limit;
+        }
+        // Overshot an exhausted grant while another member refills it.
+        while (grant.load(std::memory_order_acquire) >> 32 == base) {
+            CpuRelax();
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// How emulated workgroups obtain tile IDs. Every policy hands each worker its IDs in increasing
+// order and only hands out an ID once every lower ID is held by a running worker or done, which is
+// the "predecessors are resident or done" guarantee the single scan_bump gives the lookback.
+enum class TileAllocation {
+    Bump,       // One fetch_add on scan_bump per tile, as in the shader.
+    Batched,    // A worker reserves GRANT_TILES consecutive IDs per fetch_add, runs them in order.
+    Clustered,  // Workers in groups of CLUSTER_WORKERS share a cluster counter that is refilled
+                // CLUSTER_GRANT_TILES at a time from scan_bump, the global sequence.
+    Count,
+};
+
+const char* TileAllocationName(TileAllocation allocation);
+bool ParseTileAllocation(const char* name, TileAllocation* out);
+
+const uint32_t GRANT_TILES = 8;
+const uint32_t CLUSTER_WORKERS = 4;
+const uint32_t CLUSTER_GRANT_TILES = 32;
+
+class TileAllocator {
+   public:
+    // What one worker has been granted but not yet used. Only touched by its owner.
+    struct Cursor {
+        uint32_t next = 0;
+        uint32_t end = 0;
+    };
+
+    TileAllocator(TileAllocation allocation, uint32_t workerCount);
+
+    // Starts a new dispatch. Every cursor must be reset along with it.
+    void Reset();
+
+    // The next tile ID for worker workerIndex. IDs at or above limit mean the dispatch is done.
+    uint32_t Next(uint32_t workerIndex, Cursor& cursor, uint32_t limit);
+
+    // How many IDs have been taken from the global sequence, for stall reports.
+    uint32_t Allocated() const { return scanBump.load(std::memory_order_relaxed); }
+
+   private:
+    // A cluster's current grant: base << 32 | IDs handed out from it. The member whose increment
+    // returns exactly CLUSTER_GRANT_TILES refills it; members that overshoot hold no tile and wait
+    // for the base to change.
+    struct alignas(64) ClusterGrant {
+        std::atomic<uint64_t> grant{0};
+    };
+
+    uint32_t NextClustered(uint32_t workerIndex, uint32_t limit);
+
+    TileAllocation allocation;
+    uint32_t clusterCount;
+    alignas(64) std::atomic<uint32_t> scanBump{0};
+    std::unique_ptr<ClusterGrant[]> clusters;
+};
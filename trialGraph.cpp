@@ -0,0 +1,140 @@
+#include "trialGraph.h"
+
+#include <algorithm>
+
+#include "validate.h"
+
+namespace {
+
+const char* const STAGE_KIND_NAMES[] = {"init",     "stress",     "reduce",       "scan",
+                                        "downsweep", "copyScan", "copyErrors", "validateScan",
+                                        "validateErrors"};
+
+// Threads in the one workgroup of the scan-of-reductions pass.
+const uint32_t SCAN_REDUCTIONS_THREADS = 1024;
+
+GraphStage ComputeStage(StageKind kind, uint32_t bindings, uint32_t reads, uint32_t writes,
+                        uint32_t groups, uint32_t groupSize) {
+    GraphStage stage = {};
+    stage.kind = kind;
+    stage.queue = StageQueue::Compute;
+    stage.bindings = bindings;
+    stage.reads = reads;
+    stage.writes = writes;
+    stage.groups = groups;
+    stage.groupSize = groupSize;
+    stage.source = GraphBuffer::Count;
+    stage.destination = GraphBuffer::Count;
+    return stage;
+}
+
+GraphStage CopyStage(StageKind kind, GraphBuffer source, GraphBuffer destination) {
+    GraphStage stage = {};
+    stage.kind = kind;
+    stage.queue = StageQueue::Copy;
+    stage.reads = BufferBit(source);
+    stage.writes = BufferBit(destination);
+    stage.source = source;
+    stage.destination = destination;
+    return stage;
+}
+
+GraphStage HostStage(StageKind kind, GraphBuffer source) {
+    GraphStage stage = {};
+    stage.kind = kind;
+    stage.queue = StageQueue::Host;
+    stage.reads = BufferBit(source);
+    stage.source = source;
+    stage.destination = GraphBuffer::Count;
+    return stage;
+}
+
+}  // namespace
+
+const char* StageKindName(StageKind kind) { return STAGE_KIND_NAMES[static_cast<int>(kind)]; }
+
+TrialGraph::TrialGraph(const GraphOptions& options) : tileCount(options.tileCount) {
+    const uint32_t bump = BufferBit(GraphBuffer::ScanBump);
+    const uint32_t scan = BufferBit(GraphBuffer::Scan);
+    const uint32_t errors = BufferBit(GraphBuffer::Errors);
+    const uint32_t progress = BufferBit(GraphBuffer::Progress);
+    // In production mode the error buffer is still bound, since the kernels declare it, but
+    // nothing clears, posts to or reads it.
+    const uint32_t checked = options.checks ? errors : 0;
+
+    Add(ComputeStage(StageKind::Init, bump | scan | errors, 0, bump | scan | checked, 256, 256));
+    if (options.algorithm == ScanAlgorithm::ReduceThenScan) {
+        Add(ComputeStage(StageKind::Reduce, scan, 0, scan, tileCount, BLOCK_DIM));
+        Add(ComputeStage(StageKind::ScanReductions, scan, scan, scan, 1,
+                         SCAN_REDUCTIONS_THREADS));
+        Add(ComputeStage(StageKind::Downsweep, scan, scan, scan, tileCount, BLOCK_DIM));
+    } else {
+        Add(ComputeStage(StageKind::Stress, bump | scan | errors | progress, bump | scan,
+                         bump | scan | checked | progress, tileCount, BLOCK_DIM));
+    }
+
+    // A buffer the host can read in place needs no copy; its validator reads it directly.
+    GraphBuffer scanSource = GraphBuffer::Scan;
+    if (!(options.hostVisible & scan)) {
+        Add(CopyStage(StageKind::CopyScan, GraphBuffer::Scan, GraphBuffer::ScanCopy));
+        scanSource = GraphBuffer::ScanCopy;
+    }
+    GraphBuffer errorsSource = GraphBuffer::Errors;
+    if (options.checks && !(options.hostVisible & errors)) {
+        Add(CopyStage(StageKind::CopyErrors, GraphBuffer::Errors, GraphBuffer::ErrorsCopy));
+        errorsSource = GraphBuffer::ErrorsCopy;
+    }
+
+    Add(HostStage(StageKind::ValidateScan, scanSource));
+    if (options.checks) {
+        Add(HostStage(StageKind::ValidateErrors, errorsSource));
+    }
+}
+
+void TrialGraph::Add(GraphStage stage) {
+    stages[count] = stage;
+    for (uint32_t a = 0; a < count; ++a) {
+        if (DependsOn(a, count)) {
+            stages[count].level = std::max(stages[count].level, stages[a].level + 1);
+        }
+    }
+    ++count;
+}
+
+bool TrialGraph::DependsOn(uint32_t a, uint32_t b) const {
+    const GraphStage& first = stages[a];
+    const GraphStage& second = stages[b];
+    return (first.writes & (second.reads | second.writes)) || (first.reads & second.writes);
+}
+
+bool TrialGraph::ReportsProgress() const {
+    for (uint32_t i = 0; i < count; ++i) {
+        if (stages[i].writes & BufferBit(GraphBuffer::Progress)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TrialVerdict RunHostStages(const TrialGraph& graph,
+                           const std::function<const uint32_t*(GraphBuffer)>& hostBuffer,
+                           uint32_t tilesPerScan, uint32_t splitThreads,
+                           FailureList* failures) {
+    TrialVerdict verdict;
+    for (uint32_t i = 0; i < graph.StageCount(); ++i) {
+        const GraphStage& stage = graph.Stage(i);
+        switch (stage.kind) {
+            case StageKind::ValidateScan:
+                verdict.validScan = ValidateScan(hostBuffer(stage.source), graph.TileCount(),
+                                                 tilesPerScan, splitThreads, failures);
+                break;
+            case StageKind::ValidateErrors:
+                verdict.validErrors = ValidateErrors(hostBuffer(stage.source), graph.TileCount(),
+                                                     splitThreads, failures);
+                break;
+            default:
+                break;
+        }
+    }
+    return verdict;
+}
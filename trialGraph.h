@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "common.h"
+#include "failureLog.h"
+
+// The per-trial sequence (init, the scan passes, the copies back to the host and the validators)
+// declared once as a graph of stages over named buffers. Each stage states what it binds, reads
+// and writes, so a backend can derive the ordering it must honor instead of hard-coding it, and
+// drop or fuse stages where the dependencies allow. A graph is built once per configuration and
+// executed for every trial.
+
+// Every buffer a trial touches. The copies are the host-visible images of the device buffers.
+enum class GraphBuffer : uint32_t {
+    ScanBump,
+    Scan,
+    Errors,
+    Progress,
+    ScanCopy,
+    ErrorsCopy,
+    Count,
+};
+
+inline uint32_t BufferBit(GraphBuffer buffer) { return 1u << static_cast<uint32_t>(buffer); }
+
+// Stress is the chained scan and Reduce, ScanReductions and Downsweep the three reduce-then-scan
+// passes. The copies are the blit on the Metal path; the validators run on the host.
+enum class StageKind : uint32_t {
+    Init,
+    Stress,
+    Reduce,
+    ScanReductions,
+    Downsweep,
+    CopyScan,
+    CopyErrors,
+    ValidateScan,
+    ValidateErrors,
+    Count,
+};
+
+const char* StageKindName(StageKind kind);
+
+// Where a stage runs. Device stages (Compute, then Copy) are submitted together; Host stages run
+// once they have retired.
+enum class StageQueue : uint32_t {
+    Compute,
+    Copy,
+    Host,
+};
+
+struct GraphStage {
+    StageKind kind;
+    StageQueue queue;
+    uint32_t bindings;  // BufferBits a compute stage binds, at index = GraphBuffer value.
+    uint32_t reads;     // BufferBits read, for dependencies.
+    uint32_t writes;    // BufferBits written, for dependencies.
+    uint32_t groups;    // Compute grid: workgroups, and threads in each.
+    uint32_t groupSize;
+    GraphBuffer source;       // What a copy or a host stage reads from.
+    GraphBuffer destination;  // What a copy writes.
+    uint32_t level;  // Stages on the same level have no dependency on each other and may overlap.
+};
+
+struct GraphOptions {
+    ScanAlgorithm algorithm = ScanAlgorithm::Chained;
+    bool checks = true;  // Whether the error buffer is cleared, posted to and validated.
+    // BufferBits of device buffers the host can read in place. The copy out of each is dropped and
+    // its validator reads the buffer itself.
+    uint32_t hostVisible = 0;
+    // Tiles per dispatch, at most TEST_SIZE, which the buffers are sized for.
+    uint32_t tileCount = TEST_SIZE;
+};
+
+class TrialGraph {
+   public:
+    static const uint32_t MAX_STAGES = static_cast<uint32_t>(StageKind::Count);
+
+    explicit TrialGraph(const GraphOptions& options);
+
+    uint32_t StageCount() const { return count; }
+    const GraphStage& Stage(uint32_t i) const { return stages[i]; }
+    // Whether any stage posts to the progress buffer, i.e. whether a stall monitor has anything to
+    // watch.
+    bool ReportsProgress() const;
+    uint32_t TileCount() const { return tileCount; }
+
+    // True if stage b must not start before stage a has finished: b touches something a writes,
+    // or writes something a reads. Only meaningful for a < b.
+    bool DependsOn(uint32_t a, uint32_t b) const;
+
+   private:
+    void Add(GraphStage stage);
+
+    GraphStage stages[MAX_STAGES];
+    uint32_t count = 0;
+    uint32_t tileCount;
+};
+
+// Outcome of the host stages of one trial. A validator that is not in the graph counts as passed.
+struct TrialVerdict {
+    bool validScan = true;
+    bool validErrors = true;
+};
+
+// Runs the Host stages of graph in order. hostBuffer returns the host-visible contents of a
+// buffer named as a stage source; it is only asked for buffers the graph actually reads. Failures
+// are recorded in failures when it is non-null.
+TrialVerdict RunHostStages(const TrialGraph& graph,
+                           const std::function<const uint32_t*(GraphBuffer)>& hostBuffer,
+                           uint32_t tilesPerScan, uint32_t splitThreads,
+                           FailureList* failures = nullptr);
@@ -0,0 +1,153 @@
+#include "trialRunner.h"
+
+#include "shardRunner.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// Runs and validates a single trial on an already-allocated backend.
+bool RunTrial(CpuBackend& backend, uint32_t batchIndex, uint64_t seed, uint32_t stallIntervalMs,
+              const TrialSinks& sinks, FailureList& failures, PerfCounters* perf) {
+    TrialRecord record;
+    record.startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+    record.seed = seed;
+    record.trial = batchIndex;
+    record.configId = sinks.configId;
+    backend.SeedTrial(record.seed);
+
+    // The phases of CpuBackend::RunTrial, timed separately for the results store.
+    const bool recording = sinks.failures || sinks.results || sinks.records;
+    failures.Reset(batchIndex);
+    auto start = std::chrono::steady_clock::now();
+    backend.DispatchKernels(stallIntervalMs, perf);
+    record.dispatchMs = (float)MsSince(start);
+    start = std::chrono::steady_clock::now();
+    backend.CopyToHost();
+    // In production mode the graph has no error buffer check, and validErrors stays true.
+    const TrialVerdict verdict = RunHostStages(
+        backend.Graph(), [&backend](GraphBuffer buffer) { return backend.HostBuffer(buffer); },
+        backend.Config().tilesPerScan, backend.Config().splitThreads,
+        recording ? &failures : nullptr);
+    record.validateMs = (float)MsSince(start);
+
+    if (!verdict.validScan) {
+        printf("Batch %u: Scan buffer validation FAILED.\n", batchIndex);
+    }
+    if (!verdict.validErrors) {
+        printf("Batch %u: Error buffer check FAILED (errors recorded).\n", batchIndex);
+    }
+    if (sinks.results || sinks.records) {
+        record.failed = (verdict.validScan ? 0 : FAILED_SCAN) |
+                        (verdict.validErrors ? 0 : FAILED_ERRORS);
+        CountFailures(failures, record);
+        backend.SpinHistogram(record.spins);
+        for (uint32_t e = 0; perf && e < static_cast<uint32_t>(PerfEvent::Count); ++e) {
+            record.counters[e] = perf->Get(static_cast<PerfEvent>(e));
+        }
+        if (sinks.results) {
+            sinks.results->Append(record);
+        }
+        if (sinks.records) {
+            sinks.records->Send(record);
+        }
+    }
+    if (sinks.failures && !failures.Empty()) {
+        sinks.failures->Submit(failures);
+    }
+    return verdict.validScan && verdict.validErrors;
+}
+
+}  // namespace
+
+uint64_t TrialSeed(uint64_t campaignSeed, uint32_t batchIndex) {
+    // splitmix64.
+    uint64_t z = campaignSeed + batchIndex * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+TrialRunner::TrialRunner(const CpuConfig& config, uint32_t concurrentTrials,
+                         uint64_t campaignSeed, bool perfCounters)
+    : campaignSeed(campaignSeed), perfCounters(perfCounters) {
+    concurrentTrials = concurrentTrials ? concurrentTrials : 1;
+    pool.reserve(concurrentTrials);
+    for (uint32_t r = 0; r < concurrentTrials; ++r) {
+        CpuConfig slotConfig = config;
+        slotConfig.placementSlot = r;
+        pool.emplace_back(new CpuBackend(slotConfig));
+    }
+}
+
+TrialSummary TrialRunner::Run(uint32_t firstTrial, uint32_t count, uint32_t stallIntervalMs,
+                              const TrialSinks& sinks, bool stopAtFailure) {
+    const uint32_t concurrentTrials = static_cast<uint32_t>(pool.size());
+    std::atomic<uint32_t> nextTrial{0};
+    std::atomic<uint32_t> attempted{0};
+    std::atomic<uint32_t> passed{0};
+    std::atomic<uint32_t> firstFailure{UINT32_MAX};
+    std::mutex failedMutex;
+    std::vector<uint32_t> failedTrials;
+    auto runner = [&](CpuBackend& backend) {
+        FailureList failures;
+        // Opened here, on the thread that will spawn the workers it is to follow.
+        std::unique_ptr<PerfCounters> perf(perfCounters ? new PerfCounters : nullptr);
+        while (!stopAtFailure || firstFailure.load(std::memory_order_relaxed) == UINT32_MAX) {
+            const uint32_t i = nextTrial.fetch_add(1u, std::memory_order_relaxed);
+            if (i >= count) {
+                break;
+            }
+            const uint32_t trial = firstTrial + i;
+            attempted.fetch_add(1u, std::memory_order_relaxed);
+            if (RunTrial(backend, trial, TrialSeed(campaignSeed, trial), stallIntervalMs, sinks,
+                         failures, perf.get())) {
+                passed.fetch_add(1u, std::memory_order_relaxed);
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(failedMutex);
+                failedTrials.push_back(trial);
+            }
+            uint32_t seen = firstFailure.load(std::memory_order_relaxed);
+            while (trial < seen && !firstFailure.compare_exchange_weak(seen, trial)) {
+            }
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(concurrentTrials - 1);
+    for (uint32_t r = 1; r < concurrentTrials; ++r) {
+        threads.emplace_back(runner, std::ref(*pool[r]));
+    }
+    runner(*pool[0]);
+    for (auto& t : threads) {
+        t.join();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    const uint32_t failure = firstFailure.load();
+    return {attempted.load(), passed.load(), failure == UINT32_MAX ? 0 : failure,
+            elapsed.count(), std::move(failedTrials)};
+}
+
+TrialSummary RunTrialsConcurrently(uint32_t batchSize, uint32_t concurrentTrials,
+                                   const CpuConfig& config, uint32_t stallIntervalMs,
+                                   const TrialSinks& sinks) {
+    return TrialRunner(config, concurrentTrials).Run(1, batchSize, stallIntervalMs, sinks);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "cpuBackend.h"
+#include "resultsStore.h"
+
+// Aggregate outcome of a batch of trials.
+struct TrialSummary {
+    uint32_t attempted;
+    uint32_t passed;
+    uint32_t firstFailure;  // 1-based batch index of the earliest failing trial, 0 if none.
+    double seconds;
+    std::vector<uint32_t> failedTrials;  // Every trial that failed, in no particular order.
+};
+
+class RecordPipe;
+
+// Where the runners send what each trial produced. Any sink may be null.
+struct TrialSinks {
+    FailureWriter* failures = nullptr;  // A failed trial's records.
+    ResultsWriter* results = nullptr;   // One TrialRecord per trial.
+    RecordPipe* records = nullptr;      // The same TrialRecords, to a sharded run's launcher.
+    uint32_t configId = 0;              // The configuration's ID in results.
+};
+
+// The scheduler seed of a trial: a hash of the campaign seed and its batch index, so any trial can
+// be rerun alone.
+uint64_t TrialSeed(uint64_t campaignSeed, uint32_t batchIndex);
+
+// Runs independent CPU-backend trials, concurrentTrials at a time. Every runner thread owns one
+// CpuBackend, and with it one set of scan/bump/error buffers, for the life of the TrialRunner, so
+// the pool is allocated once rather than per trial or per call to Run. Runners claim trial indices
+// from a shared counter and fold their results into atomic counters; there are no locks on the hot
+// path. As in the serial harness, no new trials are started once one has failed, unless the caller
+// is after a failure rate rather than a reproduction. A failed trial's records go to
+// sinks.failures, so the runner can move on without waiting for them to be written. With
+// perfCounters, each runner thread opens its own PerfCounters and every TrialRecord carries the
+// events of its trial's scan passes; a runner's counters follow only the workers it spawns, so
+// concurrent trials do not count each other.
+class TrialRunner {
+   public:
+    TrialRunner(const CpuConfig& config, uint32_t concurrentTrials, uint64_t campaignSeed = 0,
+                bool perfCounters = false);
+
+    // Runs trials firstTrial to firstTrial + count - 1 and returns when all have finished, or,
+    // with stopAtFailure, when the trials in flight at the first failure have.
+    TrialSummary Run(uint32_t firstTrial, uint32_t count, uint32_t stallIntervalMs,
+                     const TrialSinks& sinks = TrialSinks(), bool stopAtFailure = true);
+
+   private:
+    std::vector<std::unique_ptr<CpuBackend>> pool;
+    uint64_t campaignSeed;
+    bool perfCounters;
+};
+
+// Runs trials 1 to batchSize on a TrialRunner of its own, with campaign seed 0.
+TrialSummary RunTrialsConcurrently(uint32_t batchSize, uint32_t concurrentTrials,
+                                   const CpuConfig& config, uint32_t stallIntervalMs,
+                                   const TrialSinks& sinks = TrialSinks());
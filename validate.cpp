@@ -0,0 +1,335 @@
+#include "validate.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Both validators first look for the earliest failing tile with a branch-free pass that ORs whole
+// blocks of differences together, split across a pool of threads, and only then walk the buffer
+// scalar from that tile, recording. A passing trial never reaches the formatting code.
+
+// Fewest words worth a thread of their own: below this, waking a pool thread costs more than the
+// share of the pass it takes over.
+const uint32_t MIN_WORDS_PER_THREAD = 1u << 16;
+const uint32_t MAX_VALIDATOR_THREADS = 4;
+
+#if defined(__GNUC__)
+// Four words: one SSE or NEON register, the baseline of every target this builds for.
+typedef uint32_t WordVector __attribute__((vector_size(16)));
+const uint32_t VECTOR_WORDS = sizeof(WordVector) / sizeof(uint32_t);
+// Vectors whose differences are ORed together before testing for any.
+const uint32_t BLOCK_VECTORS = 16;
+
+WordVector LoadVector(const uint32_t* words) {
+    WordVector v;
+    memcpy(&v, words, sizeof(v));
+    return v;
+}
+
+bool AnyBits(const WordVector& v) {
+    uint32_t any = 0;
+    for (uint32_t j = 0; j < VECTOR_WORDS; ++j) {
+        any |= v[j];
+    }
+    return any != 0;
+}
+#endif
+
+// Threads kept across calls, so that a pass pays a wakeup rather than a thread start. Started on
+// first use; Run calls that find it busy, as with concurrent trials, run on the caller alone.
+class ValidatorPool {
+   public:
+    static ValidatorPool& Get() {
+        static ValidatorPool pool;
+        return pool;
+    }
+
+    ~ValidatorPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Threads available, the caller included.
+    uint32_t Size() const { return (uint32_t)threads.size() + 1; }
+
+    // Runs part(0) through part(parts - 1), part 0 on the caller, and returns once all are done.
+    // Returns false without running anything when another caller holds the pool.
+    bool Run(uint32_t parts, const std::function<void(uint32_t)>& part) {
+        std::unique_lock<std::mutex> busy(runMutex, std::try_to_lock);
+        if (!busy) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &part;
+            jobParts = parts;
+            pending = parts - 1;
+            ++generation;
+        }
+        start.notify_all();
+        part(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return pending == 0; });
+        job = nullptr;
+        return true;
+    }
+
+   private:
+    ValidatorPool() {
+        const uint32_t count =
+            std::min(std::max(1u, std::thread::hardware_concurrency()), MAX_VALIDATOR_THREADS);
+        for (uint32_t t = 1; t < count; ++t) {
+            threads.emplace_back(&ValidatorPool::Work, this, t);
+        }
+    }
+
+    void Work(uint32_t index) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            start.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            if (index >= jobParts) {
+                continue;
+            }
+            const std::function<void(uint32_t)>* part = job;
+            lock.unlock();
+            (*part)(index);
+            lock.lock();
+            if (--pending == 0) {
+                finished.notify_one();
+            }
+        }
+    }
+
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable finished;
+    const std::function<void(uint32_t)>* job = nullptr;
+    uint32_t jobParts = 0;
+    uint32_t pending = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+};
+
+// Splits [0, count) into one range per pool thread and returns the smallest first(begin, end) over
+// the ranges; first returns end when its range is clean.
+template <class First>
+uint32_t ParallelFirst(uint32_t count, uint32_t words, const First& first) {
+    uint32_t threads = std::min(MAX_VALIDATOR_THREADS, std::max(1u, words / MIN_WORDS_PER_THREAD));
+    if (threads > 1) {
+        threads = std::min(threads, ValidatorPool::Get().Size());
+    }
+    if (threads == 1) {
+        return first(0, count);
+    }
+    uint32_t results[MAX_VALIDATOR_THREADS];
+    const uint32_t chunk = (count + threads - 1) / threads;
+    const auto run = [&](uint32_t t) {
+        const uint32_t begin = std::min(count, t * chunk);
+        const uint32_t end = std::min(count, begin + chunk);
+        const uint32_t found = first(begin, end);
+        results[t] = found < end ? found : UINT32_MAX;
+    };
+    if (!ValidatorPool::Get().Run(threads, run)) {
+        return first(0, count);
+    }
+    const uint32_t found = *std::min_element(results, results + threads);
+    return found == UINT32_MAX ? count : found;
+}
+
+// Whether every word of the tile at this position in its chain rejoins to the expected value.
+bool TileMatches(const uint32_t* scan, uint32_t tile, uint32_t position, uint32_t splitThreads) {
+    uint32_t diff = 0;
+    for (uint32_t w = 0; w < splitThreads / 2; ++w) {
+        const uint32_t index = tile * splitThreads + w * 2;
+        const uint32_t rejoined = (scan[index] & VALUE_MASK) | (scan[index + 1] << 16);
+        diff |= rejoined ^ TileWord(w) * (position + 1);
+    }
+    return diff == 0;
+}
+
+#if defined(__GNUC__)
+// Advances tile, at position in its chain, over whole blocks of matching tiles and returns the
+// first tile of the block that mismatched, or of the partial block at chainEnd. Every word is
+// compared as its 16-bit half of the expected value, so nothing has to be rejoined across lanes.
+// A group is the smallest run of whole vectors covering whole tiles: two tiles per vector at two
+// lanes, one at four, and two vectors per tile at eight. GROUP_VECTORS is a constant so that the
+// expected values stay in registers.
+template <uint32_t GROUP_VECTORS>
+uint32_t SkipMatchingBlocks(const uint32_t* scan, uint32_t tile, uint32_t chainEnd,
+                            uint32_t position, uint32_t splitThreads) {
+    const uint32_t groupTiles = std::max(1u, VECTOR_WORDS / splitThreads);
+    const uint32_t tilesPerBlock = BLOCK_VECTORS / GROUP_VECTORS * groupTiles;
+    if (chainEnd - tile < tilesPerBlock) {
+        return tile;
+    }
+    // Shifting each word up by 16 drops its flag bits and leaves its half in the top 16 bits. The
+    // low word's half is then compared with the expected value shifted up as well, and the high
+    // word's with the expected value as is, masked to its top 16 bits once per block. Both forms
+    // stay additive, so each vector costs a shift, a XOR, an OR and an add.
+    WordVector expected[GROUP_VECTORS];
+    WordVector step[GROUP_VECTORS];
+    WordVector topHalves;
+    for (uint32_t g = 0; g < GROUP_VECTORS; ++g) {
+        for (uint32_t j = 0; j < VECTOR_WORDS; ++j) {
+            const uint32_t flat = g * VECTOR_WORDS + j;
+            const uint32_t word = TileWord(flat % splitThreads / 2);
+            const uint32_t shift = j % 2 ? 0 : 16;
+            expected[g][j] = word * (position + flat / splitThreads + 1) << shift;
+            step[g][j] = word * groupTiles << shift;
+        }
+    }
+    for (uint32_t j = 0; j < VECTOR_WORDS; ++j) {
+        topHalves[j] = VALUE_MASK << 16;
+    }
+    for (; chainEnd - tile >= tilesPerBlock; tile += tilesPerBlock) {
+        const uint32_t* words = scan + tile * splitThreads;
+        WordVector diff = {};
+        for (uint32_t v = 0; v < BLOCK_VECTORS; v += GROUP_VECTORS) {
+            for (uint32_t g = 0; g < GROUP_VECTORS; ++g) {
+                diff |= LoadVector(words + (v + g) * VECTOR_WORDS) << 16 ^ expected[g];
+                expected[g] += step[g];
+            }
+        }
+        if (AnyBits(diff & topHalves)) {
+            break;
+        }
+    }
+    return tile;
+}
+#endif
+
+// The first tile in [begin, end) whose scan value is wrong, or end. Whole blocks of each chain are
+// checked vectorized, and the rest, including the block that failed, tile by tile.
+uint32_t FirstScanMismatch(const uint32_t* scan, uint32_t begin, uint32_t end,
+                           uint32_t tilesPerScan, uint32_t splitThreads) {
+    uint32_t tile = begin;
+    while (tile < end) {
+        const uint32_t position = tile % tilesPerScan;
+        const uint32_t chainEnd = std::min(end, tile - position + tilesPerScan);
+#if defined(__GNUC__)
+        tile = splitThreads > VECTOR_WORDS
+                   ? SkipMatchingBlocks<2>(scan, tile, chainEnd, position, splitThreads)
+                   : SkipMatchingBlocks<1>(scan, tile, chainEnd, position, splitThreads);
+#endif
+        for (; tile < chainEnd; ++tile) {
+            if (!TileMatches(scan, tile, tile % tilesPerScan, splitThreads)) {
+                return tile;
+            }
+        }
+    }
+    return end;
+}
+
+// The first tile in [begin, end) with a non-zero word in the error buffer, or end.
+uint32_t FirstErrorTile(const uint32_t* errors, uint32_t begin, uint32_t end,
+                        uint32_t splitThreads) {
+    const uint32_t tileWords = splitThreads * 2;
+    uint32_t tile = begin;
+#if defined(__GNUC__)
+    const uint32_t tilesPerBlock = VECTOR_WORDS * BLOCK_VECTORS / tileWords;
+    for (; end - tile >= tilesPerBlock; tile += tilesPerBlock) {
+        const uint32_t* words = errors + tile * tileWords;
+        WordVector any = {};
+        for (uint32_t v = 0; v < BLOCK_VECTORS; ++v) {
+            any |= LoadVector(words + v * VECTOR_WORDS);
+        }
+        if (AnyBits(any)) {
+            break;
+        }
+    }
+#endif
+    for (; tile < end; ++tile) {
+        uint32_t any = 0;
+        for (uint32_t i = 0; i < tileWords; ++i) {
+            any |= errors[tile * tileWords + i];
+        }
+        if (any) {
+            return tile;
+        }
+    }
+    return end;
+}
+
+// The failure kind of an ERROR_TYPE_* code.
+FailureKind ErrorKind(uint32_t errCode) {
+    switch (errCode) {
+        case ERROR_TYPE_MESSAGE:
+            return FailureKind::MessagePassing;
+        case ERROR_TYPE_SHUFFLE_READY:
+            return FailureKind::ShuffleReady;
+        case ERROR_TYPE_SHUFFLE_INC:
+            return FailureKind::ShuffleInclusive;
+        case ERROR_TYPE_SGSIZE:
+            return FailureKind::SubgroupSize;
+        default:
+            return FailureKind::Unknown;
+    }
+}
+
+}  // namespace
+
+bool ValidateScan(const uint32_t* scan, uint32_t tileCount, uint32_t tilesPerScan,
+                  uint32_t splitThreads, FailureList* failures) {
+    const uint32_t first =
+        ParallelFirst(tileCount, tileCount * splitThreads, [&](uint32_t begin, uint32_t end) {
+            return FirstScanMismatch(scan, begin, end, tilesPerScan, splitThreads);
+        });
+    if (first == tileCount) {
+        return true;
+    }
+
+    // Every tile before first passed, so recording starts there.
+    for (uint32_t k = first; failures && k < tileCount; ++k) {
+        for (uint32_t w = 0; w < splitThreads / 2; ++w) {
+            const uint32_t index = k * splitThreads + w * 2;
+            const uint32_t rejoined = (scan[index] & VALUE_MASK) | (scan[index + 1] << 16);
+            const uint32_t expected = TileWord(w) * (k % tilesPerScan + 1);
+            if (rejoined != expected) {
+                failures->Add(FailureKind::Scan, k, w * 2, rejoined, expected, scan[index],
+                              scan[index + 1]);
+            }
+        }
+    }
+    return false;
+}
+
+bool ValidateErrors(const uint32_t* errors, uint32_t tileCount, uint32_t splitThreads,
+                    FailureList* failures) {
+    const uint32_t first =
+        ParallelFirst(tileCount, tileCount * splitThreads * 2, [&](uint32_t begin, uint32_t end) {
+            return FirstErrorTile(errors, begin, end, splitThreads);
+        });
+    if (first == tileCount) {
+        return true;
+    }
+
+    // Only the first tile that posted is recorded: the kernel stops checking after its first
+    // error, and later tiles usually fail as a consequence of it.
+    for (uint32_t tid = 0; failures && tid < splitThreads; ++tid) {
+        const uint32_t index = first * splitThreads * 2 + tid * 2;
+        if (errors[index]) {
+            failures->Add(ErrorKind(errors[index]), first, tid, errors[index + 1], 0,
+                          errors[index], errors[index + 1]);
+        }
+    }
+    return false;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+#include "common.h"
+#include "failureLog.h"
+
+// Host-side checks shared by every backend. Both operate on a host-visible copy of the buffer and
+// return whether it passed. When failures is non-null, each failure is appended to it as a record
+// rather than printed; see failureLog.h.
+
+// Sanity checks the scan. scan holds tileCount * splitThreads words, forming independent chains
+// of tilesPerScan tiles each. Records every wrong word.
+bool ValidateScan(const uint32_t* scan, uint32_t tileCount = TEST_SIZE,
+                  uint32_t tilesPerScan = TEST_SIZE, uint32_t splitThreads = SPLIT_THREADS,
+                  FailureList* failures = nullptr);
+
+// Walks the error buffer, tileCount * splitThreads * 2 words, and records the errors posted by the
+// first tile that posted any.
+bool ValidateErrors(const uint32_t* errors, uint32_t tileCount = TEST_SIZE,
+                    uint32_t splitThreads = SPLIT_THREADS, FailureList* failures = nullptr);
@@ -0,0 +1,106 @@
+#include "waitPolicy.h"
+
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <climits>
+#endif
+
+namespace {
+
+const char* const WAIT_POLICY_NAMES[] = {"spin", "pause", "backoff", "park"};
+
+// Backoff doubles the number of pause hints per round up to this many, then yields.
+const uint32_t BACKOFF_MAX_PAUSES = 1024;
+// Park spins for this many rounds before going to sleep, so short waits never hit the kernel.
+const uint32_t PARK_SPIN_ROUNDS = 64;
+// Upper bound on a single sleep, a safety net against a missed wake-up.
+const long PARK_TIMEOUT_NS = 1000000;
+
+void Park(std::atomic<uint32_t>& word, uint32_t seen) {
+#ifdef __linux__
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain word");
+    const timespec timeout = {0, PARK_TIMEOUT_NS};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, seen, &timeout,
+            nullptr, 0);
+#else
+    // No portable futex before C++20's std::atomic::wait; give the core away instead.
+    (void)word;
+    (void)seen;
+    std::this_thread::yield();
+#endif
+}
+
+}  // namespace
+
+const char* WaitPolicyName(WaitPolicy policy) {
+    return WAIT_POLICY_NAMES[static_cast<int>(policy)];
+}
+
+bool ParseWaitPolicy(const char* name, WaitPolicy* out) {
+    for (int i = 0; i < static_cast<int>(WaitPolicy::Count); ++i) {
+        if (!strcmp(name, WAIT_POLICY_NAMES[i])) {
+            *out = static_cast<WaitPolicy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Waiter::Wait(std::atomic<uint32_t>& word, uint32_t seen) {
+    if (policy != WaitPolicy::Park || round < PARK_SPIN_ROUNDS) {
+        Pause();
+        return;
+    }
+    // Announce ourselves before the futex re-checks the word, so a publisher that stores after
+    // that check is guaranteed to see parked != 0 (paired with the fence in WakeWaiters).
+    lot.parked.fetch_add(1u, std::memory_order_seq_cst);
+    Park(word, seen);
+    lot.parked.fetch_sub(1u, std::memory_order_relaxed);
+}
+
+void Waiter::Pause() {
+    switch (policy) {
+        case WaitPolicy::Spin:
+            break;
+        case WaitPolicy::Backoff: {
+            const uint32_t pauses = 1u << (round < 31 ? round : 31);
+            if (pauses > BACKOFF_MAX_PAUSES) {
+                std::this_thread::yield();
+                break;
+            }
+            for (uint32_t i = 0; i < pauses; ++i) {
+                CpuRelax();
+            }
+            round++;
+            break;
+        }
+        default:
+            // Pause, and Park while it is still in its spinning phase or has no word to park on.
+            CpuRelax();
+            round++;
+            break;
+    }
+}
+
+void WakeWaiters(WaitPolicy policy, ParkingLot& lot, std::atomic<uint32_t>& word) {
+    if (policy != WaitPolicy::Park) {
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!lot.parked.load(std::memory_order_relaxed)) {
+        return;
+    }
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr,
+            nullptr, 0);
+#else
+    (void)word;
+#endif
+}
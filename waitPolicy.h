@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// What an emulated workgroup does between two polls of a scan entry that is not ready yet.
+enum class WaitPolicy {
+    Spin,     // Re-poll immediately, like the shader.
+    Pause,    // One pause (x86) / yield (ARM) hint per poll.
+    Backoff,  // Exponentially more pause hints per poll, then yield the core to the OS.
+    Park,     // Brief pause spin, then sleep on a futex until a tile publishes.
+    Count,
+};
+
+const char* WaitPolicyName(WaitPolicy policy);
+bool ParseWaitPolicy(const char* name, WaitPolicy* out);
+
+// Parked waiters across one scan buffer. Publishers only pay for a wake-up syscall while at least
+// one waiter is actually parked.
+struct ParkingLot {
+    std::atomic<uint32_t> parked{0};
+};
+
+// Per-wait-loop state for one emulated workgroup.
+class Waiter {
+   public:
+    Waiter(WaitPolicy policy, ParkingLot& lot) : policy(policy), lot(lot) {}
+
+    // Called after a poll of word returned seen without making progress.
+    void Wait(std::atomic<uint32_t>& word, uint32_t seen);
+
+    // The same, for a poll of something that cannot be parked on; Park degrades to pausing.
+    void Pause();
+
+    // Starts over from the shortest delay, for when the loop moves on to a new scan entry.
+    void Reset() { round = 0; }
+
+   private:
+    WaitPolicy policy;
+    ParkingLot& lot;
+    uint32_t round = 0;
+};
+
+// Called by a tile after it stores to one of its scan entries. Only does work under Park.
+void WakeWaiters(WaitPolicy policy, ParkingLot& lot, std::atomic<uint32_t>& word);
+
+// A single spin-loop hint to the core.
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}